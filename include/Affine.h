@@ -0,0 +1,77 @@
+#ifndef AFFINE_H
+#define AFFINE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/dual_quaternion.hpp>
+
+//affine transform kept as the top three rows of its matrix, the last row is always 0 0 0 1.
+//the layout is the same as a GLSL mat3x4 so palettes can be uploaded as they are
+struct Affine {
+	glm::vec4 row[3];
+};
+
+inline Affine affineIdentity() {
+	Affine out;
+	out.row[0] = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+	out.row[1] = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+	out.row[2] = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+	return out;
+}
+
+//same matrix as translate(t) * mat4_cast(r) * scale(s), without building the three 4x4s
+inline Affine affineFromTRS(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale) {
+	glm::mat3 r = glm::mat3_cast(rotation);
+
+	Affine out;
+	for (int i = 0; i < 3; i++)
+		out.row[i] = glm::vec4(r[0][i] * scale.x, r[1][i] * scale.y, r[2][i] * scale.z, translation[i]);
+	return out;
+}
+
+//inverse of affineFromTRS for transforms without shear
+inline void affineToTRS(const Affine &a, glm::vec3 &translation, glm::quat &rotation, glm::vec3 &scale) {
+	glm::mat3 m;
+	for (int i = 0; i < 3; i++)
+		m[i] = glm::vec3(a.row[0][i], a.row[1][i], a.row[2][i]);
+
+	translation = glm::vec3(a.row[0].w, a.row[1].w, a.row[2].w);
+	scale = glm::vec3(glm::length(m[0]), glm::length(m[1]), glm::length(m[2]));
+	for (int i = 0; i < 3; i++)
+		m[i] /= scale[i] > 0.0f ? scale[i] : 1.0f;
+	rotation = glm::normalize(glm::quat_cast(m));
+}
+
+inline Affine affineFromMat4(const glm::mat4 &m) {
+	Affine out;
+	for (int i = 0; i < 3; i++)
+		out.row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	return out;
+}
+
+inline glm::mat4 affineToMat4(const Affine &a) {
+	return glm::transpose(glm::mat4(a.row[0], a.row[1], a.row[2], glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+//composes a * b, each output row is three multiply-adds of b's rows
+inline Affine operator*(const Affine &a, const Affine &b) {
+	Affine out;
+	for (int i = 0; i < 3; i++)
+		out.row[i] = a.row[i].x * b.row[0] + a.row[i].y * b.row[1] + a.row[i].z * b.row[2] + glm::vec4(0.0f, 0.0f, 0.0f, a.row[i].w);
+	return out;
+}
+
+//rigid part of the transform as a unit dual quaternion, any scale or shear is lost
+inline glm::dualquat affineToDualQuat(const Affine &a) {
+	glm::dualquat out = glm::dualquat_cast(glm::mat3x4(a.row[0], a.row[1], a.row[2]));
+	return glm::normalize(out);
+}
+
+inline Affine affineMix(const Affine &a, const Affine &b, float factor) {
+	Affine out;
+	for (int i = 0; i < 3; i++)
+		out.row[i] = a.row[i] + (b.row[i] - a.row[i]) * factor;
+	return out;
+}
+
+#endif
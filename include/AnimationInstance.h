@@ -0,0 +1,29 @@
+#ifndef ANIMATION_INSTANCE_H
+#define ANIMATION_INSTANCE_H
+
+#include <vector>
+#include "ClipSet.h"
+#include "PoseCache.h"
+#include "Affine.h"
+
+//playback state of one character. everything it reads lives in the shared Skeleton and ClipSet,
+//so a crowd costs one of these per character on top of a single loaded model
+struct AnimationInstance {
+	unsigned int clip = 0;
+	float time = 0.0f; //seconds, of the last update
+	std::vector<KeyCursor> cursors; //one per track of the largest clip
+	std::vector<Affine> palette; //one per bone
+
+	PoseCache* poseCache = NULL;
+
+	//update-rate lod, the palette is blended from lodFrom to lodTo between evaluations. see AnimationLod
+	unsigned int lodTier = 0;
+	float lodFrameTime = -1.0f; //time of the last lod update, negative before the first
+	float lodFromTime = 0.0f;
+	float lodToTime = 0.0f;
+	bool lodWraps = false; //the clip loops between lodFrom and lodTo, so they are not blended
+	std::vector<Affine> lodFrom;
+	std::vector<Affine> lodTo;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef ANIMATION_LOD_H
+#define ANIMATION_LOD_H
+
+#include "Animator.h"
+#include "JobSystem.h"
+
+//tier t evaluates the hierarchy every 2^t frames and blends the palette in between
+const unsigned int LOD_NUM_TIERS = 4;
+
+struct LodSettings {
+	//instances further from the camera than distances[t] drop to tier t + 1
+	float distances[LOD_NUM_TIERS - 1] = { 200.0f, 500.0f, 1000.0f };
+};
+
+struct LodReport {
+	unsigned int instances[LOD_NUM_TIERS] = {}; //per tier
+	unsigned int evaluated = 0; //instances that went through the hierarchy this frame
+};
+
+//update-rate lod for crowds. distant instances evaluate their pose ahead to when their next update is due
+//and blend towards it, and instances of a tier are spread over its frames so the cost stays flat
+class AnimationLod {
+private:
+	LodSettings settings;
+	unsigned long long frame = 0;
+	std::vector<char> due; //per instance, whether it evaluates this frame
+public:
+	AnimationLod(const LodSettings &settings = LodSettings());
+
+	unsigned int tierForDistance(float distance) const;
+	//advances instance i to timesInSeconds[i] with a tier picked from distances[i]
+	LodReport update(const Animator &animator, AnimationInstance* instances, const float* timesInSeconds, const float* distances, unsigned int numInstances, JobSystem &jobs);
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef ANIMATION_PIPELINE_H
+#define ANIMATION_PIPELINE_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Animator.h"
+#include "JobSystem.h"
+
+//evaluates the next frame's palettes on a background thread while the main thread submits the current one.
+//palettes are double buffered: begin() fills the back buffer, end() waits on its fence and makes it the front.
+//between the two the instances and the job system belong to the pipeline and must not be touched
+class AnimationPipeline {
+private:
+	const Animator &animator;
+	JobSystem &jobs;
+	unsigned int numBones;
+
+	std::vector<Affine> palettes[2]; //[instance * numBones + bone]
+	unsigned int front = 0;
+
+	std::thread worker;
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	unsigned long long submitted = 0; //fence of the last begin()
+	unsigned long long completed = 0; //fence the worker signalled last
+	bool quit = false;
+	bool pending = false; //begin() without its end() yet
+
+	//request of the frame in flight, only written while the worker is idle
+	AnimationInstance* instances = NULL;
+	std::vector<float> times;
+	unsigned int numInstances = 0;
+
+	double evaluateMicros = 0.0;
+	double waitMicros = 0.0;
+
+	void workerLoop();
+	void evaluate();
+public:
+	AnimationPipeline(const Animator &animator, JobSystem &jobs);
+	~AnimationPipeline();
+	AnimationPipeline(const AnimationPipeline&) = delete;
+	AnimationPipeline& operator=(const AnimationPipeline&) = delete;
+
+	//starts evaluating instance i at timesInSeconds[i] into the back buffer and returns at once
+	void begin(AnimationInstance* instances, const float* timesInSeconds, unsigned int numInstances);
+	//waits until the frame started by the last begin() is done and returns its palettes, numBones per instance.
+	//they stay valid until the next end()
+	const Affine* end();
+	bool inFlight() const;
+
+	unsigned int getNumBones() const;
+	//of the last frame: time the worker spent evaluating, and time end() blocked the caller
+	double getEvaluateMicros() const;
+	double getWaitMicros() const;
+};
+
+#endif
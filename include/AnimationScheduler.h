@@ -0,0 +1,42 @@
+#ifndef ANIMATION_SCHEDULER_H
+#define ANIMATION_SCHEDULER_H
+
+#include <vector>
+#include "Animator.h"
+#include "JobSystem.h"
+
+struct SchedulerSettings {
+	//wall time the instances of one frame may take to evaluate
+	double budgetMicros = 2000.0;
+	//evaluated every frame whatever the budget says, so a budget set too low still makes progress
+	unsigned int minUpdates = 1;
+};
+
+struct SchedulerReport {
+	unsigned int evaluated = 0;
+	unsigned int deferred = 0;
+	double spentMicros = 0.0;
+	double overshootMicros = 0.0; //past the budget, 0 when it held
+	float averageLatency = 0.0f; //seconds the evaluated instances had waited since their last update
+	float maxLatency = 0.0f;
+	float maxDeferredLatency = 0.0f; //oldest pose left on screen this frame
+};
+
+//spends a fixed time budget per frame on the instances that need it most. importance is screen size times
+//seconds since the last update, roughly how far off on screen a stale pose is, so the rest keep their
+//last pose and move up every frame they wait and even tiny instances get their turn
+class AnimationScheduler {
+private:
+	SchedulerSettings settings;
+	double microsPerInstance = 0.0; //running estimate, wall time of one evaluation at the current thread count
+	std::vector<float> importance;
+	std::vector<unsigned int> order;
+public:
+	AnimationScheduler(const SchedulerSettings &settings = SchedulerSettings());
+
+	//screenSizes[i] is how much of the screen instance i covers, in whatever unit as long as it's the same for all
+	SchedulerReport update(const Animator &animator, AnimationInstance* instances, const float* timesInSeconds, const float* screenSizes, unsigned int numInstances, JobSystem &jobs);
+	double getMicrosPerInstance() const;
+};
+
+#endif
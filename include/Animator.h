@@ -4,47 +4,96 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <map>
+#include <memory>
 #include <glad/glad.h>
 #include "Mesh.h"
+#include "Skeleton.h"
+#include "ClipSet.h"
+#include "AnimationInstance.h"
+#include "JobSystem.h"
+#include "PoseSampler.h"
+#include "PoseCache.h"
+#include "Affine.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include "glm/gtx/string_cast.hpp"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
-struct BoneInfo {
-	glm::mat4 offset;
-	glm::mat4 finalTransform;
+struct PaletteBakeReport {
+	unsigned int clipsBaked = 0;
+	unsigned int clipsSkipped = 0;
+	size_t bytes = 0;
+	double evaluateMicros = 0.0; //average cost of one pose through the hierarchy
+	double lookupMicros = 0.0; //average cost of the same pose from the baked palettes
 };
 
+//calls work(instance) for the instances of a batch, spread over jobs' threads grain at a time. indices picks
+//which instances in what order, NULL for the first count. those bound to a pose cache are left for the calling
+//thread afterwards, in batch order, since the cache isn't safe to share between threads. every crowd update
+//goes through here, so whatever the thread count the output is the same as updating one at a time
+template <typename Work>
+void forEachInstance(const AnimationInstance* instances, const unsigned int* indices, unsigned int count, unsigned int grain, JobSystem &jobs, const Work &work) {
+	jobs.parallelFor(count, grain, [instances, indices, &work](unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; i++) {
+			unsigned int instance = indices ? indices[i] : i;
+			if (!instances[instance].poseCache)
+				work(instance);
+		}
+	});
+
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int instance = indices ? indices[i] : i;
+		if (instances[instance].poseCache)
+			work(instance);
+	}
+}
+
+//evaluates instances against a skeleton and clip set loaded once and shared by all of them.
+//evaluation only writes to the instance, so one animator can serve any number of characters
 class Animator {
 private:
-	const aiScene *scene;
-	std::map<std::string, unsigned int> boneMap;
-	unsigned int numBones = 0;
-	glm::mat4 globalITransform;
+	std::shared_ptr<Skeleton> skeleton;
+	std::shared_ptr<ClipSet> clips;
 
-	std::vector<BoneInfo> boneInfo;
 	//private methods
-	void readNodeHeirarchy(float animationTime, const aiNode* node, const glm::mat4 &parentTransform);
-	const aiNodeAnim* findNodeAnim(const aiAnimation* animation, const std::string nodeName);
-
-	unsigned int findScaling(float animationTime, const aiNodeAnim* nodeAnim);
-	unsigned int findRotation(float animationTime, const aiNodeAnim* nodeAnim);
-	unsigned int findPosition(float animationTime, const aiNodeAnim* nodeAnim);
-
-	void calcInterpolatedScaling(aiVector3D &out, float animationTime, const aiNodeAnim* nodeAnim);
-	void calcInterpolatedRotation(aiQuaternion &out, float animationTime, const aiNodeAnim* nodeAnim);
-	void calcInterpolatedPosition(aiVector3D &out, float animationTime, const aiNodeAnim* nodeAnim);
+	void evaluatePose(const Clip* clip, float animationTime, KeyCursor* cursors, Affine* palette) const;
+	void samplePalette(const BakedPalette &palettes, float animationTime, Affine* palette) const;
 public:
 	Animator(const aiScene *scene);
-	void loadBones(unsigned int meshId, const aiMesh* mesh, std::vector<VertexBoneData> &bones, std::vector<unsigned int> baseVertex);
-	std::vector<glm::mat4> boneTransform(float timeInSeconds, std::vector<glm::mat4> transforms);
+	//skeleton and clips of a cooked model, see ModelCache.h
+	Animator(CacheReader &reader);
+	void write(CacheWriter &writer) const;
+	void loadBones(unsigned int meshId, const aiMesh* mesh, std::vector<VertexBoneData> &bones, const std::vector<unsigned int> &baseVertex);
+
+	//new instance playing the first clip, with its palette sized to the bones loaded so far
+	AnimationInstance createInstance() const;
+	//advances instance to timeInSeconds and writes its pose into instance.palette
+	void update(AnimationInstance &instance, float timeInSeconds) const;
+	//same for a whole crowd, instance i goes to timesInSeconds[i], through forEachInstance
+	void update(AnimationInstance* instances, const float* timesInSeconds, unsigned int numInstances, JobSystem &jobs) const;
+	//writes the pose into a caller owned palette of at least getNumBones() entries, without allocating
+	void boneTransform(AnimationInstance &instance, float timeInSeconds, Affine* palette, unsigned int paletteSize) const;
+	unsigned int getNumBones() const;
+
+	unsigned int getNumClips() const;
+	const Clip& getClip(unsigned int clipId) const;
+	//returns the id of the clip called name, or -1 when there is none
+	int findClip(const std::string &name) const;
+
+	std::shared_ptr<const Skeleton> getSkeleton() const;
+	std::shared_ptr<const ClipSet> getClipSet() const;
+
+	//resamples every clip at samplesPerSecond so playback can index frames directly
+	BakeReport bake(float samplesPerSecond);
+	//precomputes whole skinning palettes at samplesPerSecond for as many clips as fit in budgetBytes,
+	//smallest clips first. has to run after every mesh's bones are loaded
+	PaletteBakeReport bakePalettes(float samplesPerSecond, size_t budgetBytes);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,23 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "Shader.h"
+#include "Model.h"
+
+//the --bench-* flags of main.cpp, each prints a table to std::cout
+
+//one draw per character against instanced drawing, for crowds of 1 to 4096. both go through the palette ring,
+//so past a few characters the per character draws also wait on its fences
+void benchmarkInstancing(GLFWwindow* window, Model& model, const glm::mat4& view, const glm::mat4& projection);
+//cpu stage of loading generated scenes of 6, 60 and 600 meshes on one thread and on all
+void benchmarkLoading();
+//forward playback of tracks of 100, 1k and 10k keys with key cursors against a scan from the start
+void benchmarkKeys();
+//palette upload size and per-vertex cost of linear blend and dual quaternion skinning
+void benchmarkSkinning();
+//pose cache hit rate and cost on crowds in step and out of step
+void benchmarkPoseCache(Model& model);
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef CLIP_SET_H
+#define CLIP_SET_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "Skeleton.h"
+#include "PoseSampler.h"
+#include "Affine.h"
+#include "ModelCache.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <assimp/scene.h>
+
+struct VectorKey {
+	float time;
+	glm::vec3 value;
+};
+
+struct QuatKey {
+	float time;
+	glm::quat value;
+};
+
+//keys of one animated joint, copied out of the scene so clips outlive it
+struct Track {
+	std::vector<VectorKey> scalingKeys;
+	std::vector<QuatKey> rotationKeys;
+	std::vector<VectorKey> positionKeys;
+
+	//the joint's bind pose, for a component a channel has no keys for
+	glm::vec3 bindScale = glm::vec3(1.0f);
+	glm::quat bindRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 bindPosition = glm::vec3(0.0f);
+};
+
+//last key used on each track of a joint, so forward playback doesn't search again
+struct KeyCursor {
+	unsigned int scaling = 0;
+	unsigned int rotation = 0;
+	unsigned int position = 0;
+};
+
+//clip resampled at a fixed rate, each frame is POSE_NUM_STREAMS streams of `stride` floats
+//and the last frame lies at or past the end of the clip so frame + 1 is always valid
+struct BakedClip {
+	float framesPerTick = 0.0f;
+	unsigned int numFrames = 0;
+	unsigned int numTracks = 0;
+	unsigned int stride = 0;
+	std::vector<float> samples;
+};
+
+//final skinning palettes of a whole clip, stored as [frame * numBones + bone]
+struct BakedPalette {
+	float framesPerTick = 0.0f;
+	unsigned int numFrames = 0;
+	std::vector<Affine> matrices;
+};
+
+struct Clip {
+	std::string name;
+	double duration; //ticks
+	float ticksPerSecond;
+	std::vector<Track> tracks;
+	std::vector<int> jointTracks; //track animating each joint, -1 keeps the bind pose
+	BakedClip baked;
+	BakedPalette palettes;
+};
+
+struct BakeReport {
+	unsigned int numFrames = 0;
+	size_t bytes = 0;
+	float maxScaleError = 0.0f;
+	float maxRotationError = 0.0f; //degrees
+	float maxPositionError = 0.0f;
+	float maxSamplerDifference = 0.0f; //simd sampler against the scalar one
+};
+
+//every clip of a scene, bound to the joints of one skeleton and shared by all its instances
+class ClipSet {
+private:
+	std::vector<Clip> clips;
+	std::map<std::string, unsigned int> clipMap;
+	unsigned int maxTracks = 0;
+
+	void registerClip(const aiAnimation* animation, const Skeleton &skeleton);
+	void setBindPose(Clip &clip, const Skeleton &skeleton);
+	BakedClip bakeClip(const Clip &clip, float samplesPerSecond, BakeReport &report) const;
+public:
+	ClipSet(const aiScene* scene, const Skeleton &skeleton);
+	//reads back the source keys stored with write, bakes are not stored and have to be redone.
+	//skeleton is the one read just before, the bind poses of the tracks come from it
+	ClipSet(CacheReader &reader, const Skeleton &skeleton);
+	void write(CacheWriter &writer) const;
+
+	unsigned int getNumClips() const;
+	const Clip& getClip(unsigned int clipId) const;
+	//returns the id of the clip called name, or -1 when there is none
+	int findClip(const std::string &name) const;
+	//most tracks any clip has, which is how many cursors an instance needs
+	unsigned int getMaxTracks() const;
+
+	//resamples every clip at samplesPerSecond so playback can index frames directly
+	BakeReport bake(float samplesPerSecond);
+	void setPalettes(unsigned int clipId, const BakedPalette &palettes);
+};
+
+void sampleTrack(const Track &track, float animationTime, KeyCursor &cursor, glm::vec3 &scale, glm::quat &rotation, glm::vec3 &position);
+void sampleBaked(const BakedClip &baked, float animationTime, int track, glm::vec3 &scale, glm::quat &rotation, glm::vec3 &position);
+void readPose(const float* pose, unsigned int stride, int track, glm::vec3 &scale, glm::quat &rotation, glm::vec3 &position);
+void writePose(float* pose, unsigned int stride, int track, const glm::vec3 &scale, const glm::quat &rotation, const glm::vec3 &position);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <vector>
+#include <cstddef>
+#include <glad/glad.h>
+#include "Mesh.h"
+
+//every mesh of a model in one vertex buffer, one bone weight buffer and one index buffer behind a single VAO.
+//meshes are drawn out of it with glDrawElementsBaseVertex, so they share the buffers and the VAO binding.
+//the arena owns its gl objects and deletes them with itself, so it can be moved but not copied
+class GeometryArena {
+private:
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<VertexBoneData> bones; //one per arena vertex
+
+	//what was uploaded, kept when the cpu copies are released
+	unsigned int numVertices = 0;
+	unsigned int numIndices = 0;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+
+	unsigned int VAO = 0, VBO = 0, boneVBO = 0, EBO = 0;
+	//bytes of the vertex, bone weight and index arrays sent so far, in that order
+	size_t uploadedBytes = 0;
+
+	void release();
+	//allocates the buffers at full size and sets up the VAO, the data follows in uploadSome
+	void createBuffers();
+public:
+	GeometryArena();
+	~GeometryArena();
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+	GeometryArena(GeometryArena &&other);
+	GeometryArena& operator=(GeometryArena &&other);
+
+	//places a mesh's vertices at baseVertex, so they line up with the bone weights loaded for it, and appends its indices
+	MeshRange addMesh(unsigned int baseVertex, const std::vector<Vertex> &meshVertices, const std::vector<unsigned int> &meshIndices);
+	//takes the model wide bone weights, indexed like the vertices
+	void setBones(std::vector<VertexBoneData> &bones);
+	//takes whole vertex and index arrays of an arena written out earlier, in place of addMesh
+	void setGeometry(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
+	//creates the gl buffers from what was added so far
+	void upload();
+	//the same spread over several calls: the first creates the buffers, each call sends at most maxBytes of the data
+	//and returns how much it sent. the arena can be drawn once isUploaded, the arrays must not change until then
+	size_t uploadSome(size_t maxBytes);
+	bool isUploaded() const;
+	//frees the vertex, index and bone weight arrays once the gpu has them. counts and bounds stay
+	void releaseCpuCopies();
+
+	void bind() const;
+	void unbind() const;
+
+	const std::vector<Vertex>& getVertices() const;
+	const std::vector<unsigned int>& getIndices() const;
+	const std::vector<VertexBoneData>& getBones() const;
+	unsigned int getNumVertices() const;
+	unsigned int getNumIndices() const;
+	//axis aligned box around every vertex in the bind pose
+	const glm::vec3& getBoundsMin() const;
+	const glm::vec3& getBoundsMax() const;
+	//bytes the buffers take on the gpu, and the cpu copies still held
+	size_t getGpuBytes() const;
+	size_t getCpuBytes() const;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+//fixed pool of worker threads that split index ranges between them. each thread starts on its own
+//slice and, once that is drained, steals chunks from the others, so uneven jobs still finish together.
+//chunks are claimed with a single atomic add, only starting and finishing a batch takes the lock
+class JobSystem {
+private:
+	//one per thread, each on a cache line of its own so claiming chunks doesn't bounce lines between cores.
+	//the vector's allocations honour the alignment from C++17 on, which aligned new needs
+	struct alignas(64) Slice {
+		std::atomic<unsigned int> next;
+		unsigned int end;
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<Slice> slices;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	unsigned long long batch = 0;
+	unsigned int busyWorkers = 0;
+	bool quit = false;
+
+	//current batch, only written while every worker is idle
+	const std::function<void(unsigned int, unsigned int)>* job = NULL;
+	unsigned int grain = 1;
+
+	std::atomic<unsigned long long> steals;
+
+	void workerLoop(unsigned int thread);
+	void runSlices(unsigned int thread);
+public:
+	//numThreads counts the calling thread, 0 uses every hardware thread
+	JobSystem(unsigned int numThreads = 0);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	//calls job(begin, end) on ranges of at most grain indices covering [0, count) and returns once all are done.
+	//the calling thread takes part, so nesting calls from inside a job is not supported
+	void parallelFor(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)> &job);
+
+	unsigned int getNumThreads() const;
+	//chunks run by a thread other than the one whose slice they were in
+	unsigned long long getSteals() const;
+};
+
+#endif
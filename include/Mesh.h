@@ -52,19 +52,34 @@ struct Texture {
 	std::string path;
 };
 
+//where a mesh lives in its model's GeometryArena. indices are local to the mesh and offset by baseVertex when drawn
+struct MeshRange {
+	unsigned int firstIndex = 0;
+	unsigned int numIndices = 0;
+	unsigned int baseVertex = 0;
+	unsigned int numVertices = 0;
+};
+
+//one material's part of a model. the geometry is in the model's arena, which has to be bound when drawing,
+//and the textures belong to the model. meshes are only moved, never copied
 class Mesh {
 private:
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
+	MeshRange range;
 	std::vector<Texture> textures;
-	std::vector<VertexBoneData> bones;
 
-	unsigned int VAO, VBO, boneVBO, EBO;
-
-	void loadMesh();
+	void bindTextures(Shader &shader);
 public:
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, std::vector<VertexBoneData> bones);
+	Mesh(const MeshRange &range, std::vector<Texture> textures);
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&&) = default;
+	Mesh& operator=(Mesh&&) = default;
 	void draw(Shader &shader);
+	//one call for every instance, the shader tells them apart by gl_InstanceID
+	void drawInstanced(Shader &shader, unsigned int numInstances);
+
+	const MeshRange& getRange() const;
+	const std::vector<Texture>& getTextures() const;
 };
 
 #endif
\ No newline at end of file
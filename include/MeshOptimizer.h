@@ -0,0 +1,45 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include <cstddef>
+#include "Mesh.h"
+
+//post-transform cache the simulator models, a FIFO of this many vertices as on most hardware of the last decade
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+	unsigned int triangles = 0;
+	unsigned int vertices = 0; //referenced by at least one triangle
+	unsigned int transforms = 0; //vertices that missed the cache and had to be shaded
+	//average cache miss ratio, transforms per triangle: 3 is no reuse at all, 0.5 the best a regular grid allows
+	float acmr = 0.0f;
+	//average transform to vertex ratio, transforms per vertex: 1 means every vertex is shaded exactly once
+	float atvr = 0.0f;
+};
+
+//runs a triangle list through a FIFO vertex cache of cacheSize entries and counts the misses
+VertexCacheStats simulateVertexCache(const unsigned int* indices, size_t numIndices, unsigned int numVertices, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+//adds the counts of b to a and works the ratios out again, for totals over several meshes
+void addVertexCacheStats(VertexCacheStats &a, const VertexCacheStats &b);
+
+//reorders triangles so consecutive ones share vertices, with Tom Forsyth's greedy scoring over a simulated LRU cache.
+//the cache it scores against is larger than VERTEX_CACHE_SIZE, which keeps the order good on bigger caches too
+void optimizeVertexCache(unsigned int* indices, size_t numIndices, unsigned int numVertices);
+//regroups the cache optimized triangles into runs that start on a cold cache and draws the runs facing out of the
+//mesh first, so fewer hidden fragments get shaded. runs stay intact, the cache misses barely change
+void optimizeOverdraw(unsigned int* indices, size_t numIndices, const Vertex* vertices, unsigned int numVertices);
+//renumbers vertices in the order the triangles first use them, so vertex fetch walks memory forwards.
+//rewrites indices and returns the new place of every old vertex, apply it to each vertex array with remapVertices.
+//vertices no triangle uses are kept, after the used ones
+std::vector<unsigned int> optimizeVertexFetch(unsigned int* indices, size_t numIndices, unsigned int numVertices);
+
+template <typename T>
+void remapVertices(T* vertices, const std::vector<unsigned int> &remap) {
+	std::vector<T> original(vertices, vertices + remap.size());
+	for (unsigned int i = 0; i < remap.size(); i++) {
+		vertices[remap[i]] = original[i];
+	}
+}
+
+#endif
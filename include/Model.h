@@ -4,10 +4,16 @@
 #include "Shader.h"
 #include "Mesh.h"
 #include "Animator.h"
+#include "PaletteRing.h"
+#include "GeometryArena.h"
+#include "MeshOptimizer.h"
+#include "ModelCache.h"
+#include "JobSystem.h"
 
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 
 #include <GLFW/glfw3.h>
 
@@ -22,29 +28,177 @@
 
 #include "stb_image.h"
 
+enum SkinningMode {
+	SKINNING_LINEAR, //mat3x4 palette streamed by drawInstanced, shaders/vertexShaderInstanced.vs
+	SKINNING_DUAL_QUATERNION //mat2x4 dual quaternion palette, shaders/vertexShaderDQ.vs
+};
+
+//uniform buffer binding point of the Palette block in shaders/vertexShaderDQ.vs.
+//every program that skins the model points its block here with Shader::setBlock
+const unsigned int PALETTE_BLOCK_BINDING = 0;
+
+//what assimp is asked to do on import, see importFlags for the exact steps
+enum ImportProfile {
+	IMPORT_FAST_LOAD, //only what the shaders need, geometry stays as the file has it
+	IMPORT_RUNTIME_OPTIMAL, //welded, limited to MAX_NUM_BONES weights, merged and reordered for the vertex cache
+	IMPORT_EDITOR //welded and validated but meshes and triangle order kept as authored
+};
+
+unsigned int importFlags(ImportProfile profile);
+const char* importProfileName(ImportProfile profile);
+//reads "fast-load", "runtime-optimal" or "editor", returns false for anything else
+bool parseImportProfile(const std::string &name, ImportProfile &profile);
+
+struct ModelSettings {
+	ImportProfile profile = IMPORT_RUNTIME_OPTIMAL;
+	//rate animations are resampled at on load, 0 keeps the source keys
+	float bakeRate = 0.0f;
+	//bytes this model may spend on fully baked skinning palettes, 0 turns them off
+	size_t paletteBudget = 0;
+	float paletteRate = 30.0f;
+	//has to match the vertex shader the model is drawn with
+	SkinningMode skinning = SKINNING_LINEAR;
+	//after import, reorder each mesh's triangles for the vertex cache and its vertices for fetch order.
+	//the result is what gets cooked, so warm loads get it for free
+	bool optimizeGeometry = true;
+	//with optimizeGeometry, also draw the outward facing parts of each mesh first to cut overdraw
+	bool optimizeOverdraw = false;
+	//load from a cooked copy next to the source, path.<profile>.cooked, while the source is unchanged,
+	//and write one after every import from the source
+	bool useCache = true;
+	//frees the cpu copies of the geometry once it is on the gpu, keeping counts and bounds.
+	//the cooked cache is written before, so it is unaffected
+	bool releaseCpuGeometry = false;
+	//spreads mesh conversion and texture decoding over its threads at load, NULL makes a pool just for the load.
+	//nothing else may be running jobs on it while the model loads
+	JobSystem* jobs = NULL;
+};
+
+//decoded pixels of a texture file waiting for their gl upload
+struct TextureImage {
+	unsigned char* data = NULL;
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+};
+
+//where the time of the last load went. the cpu stage runs on the job system, workMillis is what it
+//would have cost on one thread, and the gl stage runs on the thread calling uploadSome, summed over its calls
+struct LoadTimes {
+	double importMillis = 0.0; //assimp itself, 0 when loaded from the cooked cache
+	double cpuMillis = 0.0;
+	double workMillis = 0.0;
+	double glMillis = 0.0;
+};
+
+//what the draw calls of a model cost since the last resetDrawStats
+struct DrawStats {
+	unsigned int drawCalls = 0;
+	unsigned int instances = 0;
+	size_t uploadBytes = 0; //palette data sent to the gpu
+};
+
 class Model {
 private:
 	std::vector<Texture> loaded_textures;
 	std::vector<Mesh> meshes;
 	std::string dir;
-	const aiScene* scene;
 	std::vector<unsigned int> baseVertex;
 	unsigned int totalVertices = 0;
-	Animator *animator;
-	//bones
-	std::vector<VertexBoneData> bones;
+	Animator *animator = NULL;
+	ModelSettings settings;
+	//vertices, bone weights and indices of every mesh, meshes only hold their range of it
+	GeometryArena geometry;
+	AnimationInstance defaultInstance; //played by the overloads without an instance
+	std::vector<glm::dualquat> dualPalette;
+	//instanced drawing streams the model matrix then the palette of every instance through here
+	PaletteRing* paletteRing = NULL;
+	DrawStats drawStats;
+	LoadTimes loadTimes;
+	//uniform buffer behind the Palette block of dual quaternion skinning, written once per palette whatever number of programs read it
+	unsigned int paletteBlock = 0;
+	unsigned int paletteBlockBones = 0; //the skeleton's bones, 0 when there is no block
+
+	//left by the cpu stage of the load for the gl one. images line up with loaded_textures, whose ids stay 0
+	//until uploaded, and meshes are only made once their textures are
+	struct PendingMesh {
+		MeshRange range;
+		std::vector<unsigned int> textures; //into loaded_textures
+	};
+	std::vector<TextureImage> textureImages;
+	std::vector<PendingMesh> pendingMeshes;
+	unsigned int nextTexture = 0; //first texture not uploaded yet
+	bool failed = false;
+	bool resident = false;
 
 	//loading model methods
-	void loadModel(const std::string &path);
-	void processNode(aiNode *node, const aiScene *scene);
-	Mesh processMesh(unsigned int meshId, aiMesh *mesh, const aiScene *scene);
-	std::vector<Texture> getMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName);
+	bool loadModel(const std::string &path);
+	bool importModel(const std::string &path, JobSystem &jobs);
+	bool readCooked(const std::string &cookedPath, unsigned long long sourceHash, double &coldMillis, JobSystem &jobs);
+	void writeCooked(const std::string &cookedPath, unsigned long long sourceHash, double coldMillis) const;
+	void setupAnimation();
+	//scene meshes in node order, which is the order they are drawn in
+	void collectMeshes(const aiNode *node, std::vector<unsigned int> &meshOrder) const;
+	//converts one mesh's vertices and faces, safe to run on several meshes at once
+	void processMesh(const aiMesh *mesh, std::vector<Vertex> &vertices, std::vector<unsigned int> &indices) const;
+	//runs the MeshOptimizer passes on one converted mesh, bones are its weights and get reordered with the vertices
+	void optimizeMesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, VertexBoneData* bones, VertexCacheStats &before, VertexCacheStats &after) const;
+	unsigned int geometryFlags() const;
+	void getMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName, std::vector<std::string> &paths, std::vector<std::string> &types) const;
+	//decodes the files not loaded yet on jobs and returns where each path is in loaded_textures
+	std::vector<unsigned int> loadTextures(const std::vector<std::string> &paths, const std::vector<std::string> &types, JobSystem &jobs);
+	//last step of the gl stage, once the geometry and textures are up
+	void finishUpload();
+	//instances one draw can take, as many as fit a region of the palette ring
+	unsigned int getInstanceBatch();
+	Affine* mapInstanceData(unsigned int numInstances);
+	void drawInstanceData(Shader &shader, unsigned int numInstances);
+	void createPaletteBlock();
 public:
-	Model(const char *path);
+	//upload false stops after the cpu stage, which makes no gl calls and can run on any thread. the gl stage is
+	//then left to uploadSome on the gl thread, and the model draws nothing until it is resident
+	Model(const char *path, const ModelSettings &settings = ModelSettings(), bool upload = true);
+	//destroy on the gl thread, unless nothing was uploaded yet
+	~Model();
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+	//draws with the palette in the Palette block, dual quaternion skinning only. linear blend characters are
+	//drawn with drawInstanced, a single one as an instance count of 1
 	void draw(Shader& shader);
+	//draws numInstances characters with one call per mesh, instance i posed by instances[i] and placed by transforms[i].
+	//needs shaders/vertexShaderInstanced.vs and linear blend skinning
+	void drawInstanced(Shader& shader, const AnimationInstance* instances, const glm::mat4* transforms, unsigned int numInstances);
+	//same with the palettes packed back to back, getNumBones() each, as AnimationPipeline hands them out
+	void drawInstanced(Shader& shader, const Affine* palettes, const glm::mat4* transforms, unsigned int numInstances);
+	//runs gl stage steps until about maxBytes were sent and returns the bytes sent: the geometry goes in chunks,
+	//textures one whole texture per step. at least one step runs, so a texture larger than maxBytes still gets through
+	size_t uploadSome(size_t maxBytes);
+	bool isResident() const;
+	//the file could not be imported, the model stays empty
+	bool hasFailed() const;
+	const DrawStats& getDrawStats() const;
+	const LoadTimes& getLoadTimes() const;
+	const GeometryArena& getGeometry() const;
+	void resetDrawStats();
 
 	//animation
-	void playAnimation(float time, Shader& shader);
+	bool setAnimation(const std::string &name);
+	void setPoseCache(PoseCache* cache);
+	void playAnimation(float time);
+
+	//extra characters sharing this model's meshes, skeleton and clips
+	AnimationInstance createInstance() const;
+	bool setAnimation(AnimationInstance &instance, const std::string &name) const;
+	void playAnimation(AnimationInstance &instance, float time);
+	//sends an already updated palette to the Palette uniform block at PALETTE_BLOCK_BINDING, dual quaternion skinning only
+	void uploadPalette(const AnimationInstance &instance);
+	void uploadPalette(const Affine* palette);
+	//MAX_BONES for shaders/vertexShaderDQ.vs, pass it as the defines of its Shader
+	std::string getShaderDefines() const;
+	unsigned int getNumBones() const;
+	//for evaluating crowds of instances in batches
+	const Animator& getAnimator() const;
+	SkinningMode getSkinningMode() const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+//bump whenever anything written to a cooked file changes shape, older files are then reimported
+const unsigned int COOKED_VERSION = 3;
+const char COOKED_MAGIC[4] = { 'C', 'O', 'O', 'K' };
+
+//64 bit FNV-1a of the bytes of path, continued from hash. a missing file leaves hash as it is
+unsigned long long hashFile(const std::string &path, unsigned long long hash = 14695981039346656037ULL);
+//hash of everything the importer reads for path: the file itself plus, for .md5mesh, the .md5anim next to it
+unsigned long long hashModelSource(const std::string &path);
+
+//cooked files are flat: plain values and arrays of them stored as their bytes, each array after its length.
+//nothing is parsed on the way back in, arrays are copied straight out of the file
+class CacheWriter {
+private:
+	std::vector<char> data;
+public:
+	void writeBytes(const void* bytes, size_t size);
+	void writeString(const std::string &value);
+
+	template <typename T>
+	void write(const T &value) {
+		writeBytes(&value, sizeof(T));
+	}
+
+	template <typename T>
+	void writeArray(const std::vector<T> &values) {
+		write((unsigned long long)values.size());
+		if (!values.empty())
+			writeBytes(&values[0], values.size() * sizeof(T));
+	}
+
+	size_t getSize() const;
+	bool save(const std::string &path) const;
+};
+
+//reads back what CacheWriter wrote. running past the end doesn't throw, it marks the reader failed
+//and returns zeros, so callers check failed() once after reading everything
+class CacheReader {
+private:
+	std::vector<char> data;
+	size_t offset = 0;
+	bool fail = false;
+public:
+	bool load(const std::string &path);
+
+	void readBytes(void* bytes, size_t size);
+	std::string readString();
+	//length of a list written with write, checked against what is left of the file so a bad one can't allocate
+	size_t readCount();
+
+	template <typename T>
+	T read() {
+		T value;
+		std::memset((void*)&value, 0, sizeof(T));
+		readBytes(&value, sizeof(T));
+		return value;
+	}
+
+	template <typename T>
+	void readArray(std::vector<T> &values) {
+		unsigned long long count = read<unsigned long long>();
+		if (fail || count > (data.size() - offset) / sizeof(T)) {
+			fail = true;
+			values.clear();
+			return;
+		}
+
+		values.resize((size_t)count);
+		if (count > 0)
+			readBytes(&values[0], (size_t)count * sizeof(T));
+	}
+
+	bool failed() const;
+	//for readers that find what they read doesn't hold together, the load then falls back to importing
+	void setFailed();
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <string>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "Model.h"
+#include "JobSystem.h"
+
+enum ModelLoadState {
+	MODEL_PENDING, //queued, or being imported and decoded on the loading thread
+	MODEL_CPU_READY, //in memory, its gl uploads waiting on ModelLoader::update
+	MODEL_RESIDENT, //uploaded and ready to draw
+	MODEL_FAILED, //the file could not be imported
+	MODEL_CANCELLED
+};
+
+//one load, shared by its handles and the loader
+struct ModelLoad {
+	std::string path;
+	ModelSettings settings;
+	std::atomic<ModelLoadState> state;
+	std::atomic<bool> cancelled;
+	std::unique_ptr<Model> model; //set by the loading thread once the cpu stage is done
+
+	ModelLoad(const std::string &path, const ModelSettings &settings);
+};
+
+//what ModelLoader::load hands back, copies refer to the same load. the model belongs to the load and goes
+//with the last handle, which has to be let go of on the gl thread once anything was uploaded
+class ModelHandle {
+private:
+	std::shared_ptr<ModelLoad> load;
+public:
+	ModelHandle();
+	ModelHandle(const std::shared_ptr<ModelLoad> &load);
+
+	ModelLoadState getState() const;
+	//the model once it is resident, NULL before
+	Model* get() const;
+	//stops the load at its next step. an import already running finishes first and is then thrown away,
+	//a model already resident stays
+	void cancel();
+	bool isValid() const;
+};
+
+//what the last ModelLoader::update did
+struct UploadReport {
+	size_t bytes = 0;
+	double millis = 0.0;
+	unsigned int modelsResident = 0; //finished by this update
+	unsigned int modelsWaiting = 0; //cpu ready models still uploading or queued to
+};
+
+//loads models without stalling the frame. a loading thread runs the cpu stage of each load, import or cooked
+//read, mesh processing and texture decoding, one model at a time on the loader's own job system. the gl stage
+//is queued and drained by update on the gl thread under a byte and time budget, so a new model costs a
+//few frames a bounded amount each instead of one long one. create and destroy the loader on the gl thread
+class ModelLoader {
+private:
+	JobSystem jobs; //only used by the loading thread, whatever settings.jobs the loads ask for
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<std::shared_ptr<ModelLoad>> pending; //waiting for the loading thread
+	std::deque<std::shared_ptr<ModelLoad>> uploads; //cpu ready, in the order update takes them
+	bool quit = false;
+	UploadReport lastUpdate;
+
+	void workerLoop();
+public:
+	//numThreads for the loads' job system, counting the loading thread. kept low by default so streaming
+	//doesn't compete with the frame's own jobs
+	ModelLoader(unsigned int numThreads = 2);
+	~ModelLoader();
+	ModelLoader(const ModelLoader&) = delete;
+	ModelLoader& operator=(const ModelLoader&) = delete;
+
+	//queues path and returns at once
+	ModelHandle load(const std::string &path, const ModelSettings &settings = ModelSettings());
+	//call once a frame on the gl thread: uploads the waiting models in order until maxBytes were sent or
+	//maxMillis went by, and drops the cancelled ones and those nobody holds a handle to any more.
+	//one step always runs, so a texture bigger than maxBytes still gets through on its own
+	const UploadReport& update(size_t maxBytes, double maxMillis);
+	const UploadReport& getLastUpdate() const;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef PALETTE_RING_H
+#define PALETTE_RING_H
+
+#include <vector>
+#include <cstddef>
+#include <glad/glad.h>
+#include "Affine.h"
+
+//GL 4.4 / ARB_buffer_storage, the loader only knows 3.3
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
+const unsigned int PALETTE_RING_REGIONS = 3;
+
+//streams palettes to the gpu through one texture buffer split into PALETTE_RING_REGIONS regions, used in turn.
+//each region is fenced after the draws reading it and only rewritten once the fence has passed.
+//with glBufferStorage the buffer stays persistently mapped and palettes are written straight into it,
+//on plain GL 3.3 they are staged in memory and sent with glBufferSubData
+class PaletteRing {
+private:
+	typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+	BufferStorageProc bufferStorage = NULL;
+
+	unsigned int buffer = 0;
+	unsigned int texture = 0;
+	size_t regionSize = 0; //in Affines
+	size_t maxRegionSize = 0; //what GL_MAX_TEXTURE_BUFFER_SIZE leaves each region, in Affines
+	Affine* mapped = NULL;
+	std::vector<Affine> staging;
+
+	GLsync fences[PALETTE_RING_REGIONS] = {};
+	unsigned int region = 0;
+	size_t mappedCount = 0;
+
+	unsigned long long stalls = 0;
+
+	void allocate(size_t count);
+	void release();
+	void waitRegion(unsigned int region);
+public:
+	PaletteRing();
+	~PaletteRing();
+	PaletteRing(const PaletteRing&) = delete;
+	PaletteRing& operator=(const PaletteRing&) = delete;
+
+	//space for count Affines in the next region, write the palettes there then call unmap.
+	//count may not exceed getMaxCount()
+	Affine* map(size_t count);
+	//makes the written palettes visible to the gpu and returns their first texel
+	int unmap();
+	//call after the draws that read the last unmapped region
+	void fence();
+
+	unsigned int getTexture() const;
+	//most Affines one map can hold, the texture buffer size limit split between the regions
+	size_t getMaxCount() const;
+	bool isPersistent() const;
+	//times map had to wait for the gpu to finish with a region
+	unsigned long long getStalls() const;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef POSE_CACHE_H
+#define POSE_CACHE_H
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstddef>
+
+#include "Affine.h"
+
+struct PoseKey {
+	const void* skeleton;
+	unsigned int clip;
+	unsigned int sample;
+
+	bool operator==(const PoseKey &other) const {
+		return skeleton == other.skeleton && clip == other.clip && sample == other.sample;
+	}
+};
+
+struct PoseKeyHash {
+	size_t operator()(const PoseKey &key) const {
+		size_t hash = std::hash<const void*>()(key.skeleton);
+		hash = hash * 31 + key.clip;
+		hash = hash * 31 + key.sample;
+		return hash;
+	}
+};
+
+//finished bone palettes shared between instances that play the same clip at the same quantized time,
+//least recently used palettes are dropped once capacity is reached
+class PoseCache {
+private:
+	struct Entry {
+		PoseKey key;
+		std::vector<Affine> palette;
+	};
+
+	unsigned int capacity;
+	float samplesPerSecond;
+	std::list<Entry> entries;
+	std::unordered_map<PoseKey, std::list<Entry>::iterator, PoseKeyHash> lookup;
+
+	unsigned long long hits = 0;
+	unsigned long long misses = 0;
+public:
+	PoseCache(unsigned int capacity, float samplesPerSecond);
+
+	//index of the cached sample at or before timeInSeconds, and the time it was taken at
+	unsigned int quantize(float timeInSeconds) const;
+	float sampleTime(unsigned int sample) const;
+
+	//copies the cached palette for key and returns true, or counts a miss and returns false
+	bool fetch(const PoseKey &key, Affine* palette, unsigned int paletteSize);
+	void store(const PoseKey &key, const Affine* palette, unsigned int paletteSize);
+	void clear();
+
+	unsigned long long getHits() const;
+	unsigned long long getMisses() const;
+	unsigned int getSize() const;
+	size_t getBytes() const;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef POSE_SAMPLER_H
+#define POSE_SAMPLER_H
+
+//tracks of a pose are padded to a multiple of this so the widest kernel never reads past a stream
+#define POSE_LANES 8
+
+//a pose is stored as structure-of-arrays, one stream of floats per component
+enum PoseStream {
+	POSE_SCALE_X,
+	POSE_SCALE_Y,
+	POSE_SCALE_Z,
+	POSE_ROTATION_X,
+	POSE_ROTATION_Y,
+	POSE_ROTATION_Z,
+	POSE_ROTATION_W,
+	POSE_POSITION_X,
+	POSE_POSITION_Y,
+	POSE_POSITION_Z,
+	POSE_NUM_STREAMS
+};
+
+//interpolates every track between two poses of `stride` lanes per stream and renormalises the rotations
+void samplePoseScalar(const float* current, const float* next, float factor, unsigned int stride, float* out);
+void samplePoseSimd(const float* current, const float* next, float factor, unsigned int stride, float* out);
+
+inline unsigned int poseStride(unsigned int numTracks) {
+	return (numTracks + POSE_LANES - 1) / POSE_LANES * POSE_LANES;
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef SELF_CHECK_H
+#define SELF_CHECK_H
+
+#include "Model.h"
+#include "AnimationLod.h"
+#include "AnimationScheduler.h"
+#include "AnimationPipeline.h"
+
+//cpu ports of the skinning in shaders/vertexShaderInstanced.vs and shaders/vertexShaderDQ.vs, operation for operation
+inline glm::vec3 skinLinear(const Affine* bones, const glm::ivec4 &ids, const glm::vec4 &weights, const glm::vec3 &position) {
+	Affine blended;
+	for (int r = 0; r < 3; r++)
+		blended.row[r] = bones[ids[0]].row[r] * weights[0] + bones[ids[1]].row[r] * weights[1] + bones[ids[2]].row[r] * weights[2] + bones[ids[3]].row[r] * weights[3];
+
+	glm::vec4 point(position, 1.0f);
+	return glm::vec3(glm::dot(point, blended.row[0]), glm::dot(point, blended.row[1]), glm::dot(point, blended.row[2]));
+}
+
+inline glm::vec3 skinDualQuat(const glm::dualquat* bones, const glm::ivec4 &ids, const glm::vec4 &weights, const glm::vec3 &position) {
+	const glm::dualquat &dq0 = bones[ids[0]];
+	glm::vec4 first(dq0.real.x, dq0.real.y, dq0.real.z, dq0.real.w);
+	glm::vec4 real = first * weights[0];
+	glm::vec4 dual = glm::vec4(dq0.dual.x, dq0.dual.y, dq0.dual.z, dq0.dual.w) * weights[0];
+
+	for (int i = 1; i < 4; i++) {
+		const glm::dualquat &dq = bones[ids[i]];
+		glm::vec4 r(dq.real.x, dq.real.y, dq.real.z, dq.real.w);
+		float hemisphere = glm::dot(first, r) < 0.0f ? -1.0f : 1.0f;
+		real += r * (weights[i] * hemisphere);
+		dual += glm::vec4(dq.dual.x, dq.dual.y, dq.dual.z, dq.dual.w) * (weights[i] * hemisphere);
+	}
+
+	float len = glm::length(real);
+	real /= len;
+	dual /= len;
+
+	glm::vec3 r(real), d(dual);
+	glm::vec3 out = position + 2.0f * glm::cross(r, glm::cross(r, position) + real.w * position);
+	return out + 2.0f * (real.w * d - dual.w * r + glm::cross(r, d));
+}
+
+//pass/fail comparisons of the optimised animation paths against their reference ones, run by --self-check.
+//each prints what it compared and how far apart the results were, and returns false past its tolerance
+
+//samplePoseSimd against samplePoseScalar, on random poses and on every frame pair of the model's baked clips
+bool checkPoseSampler(const Animator &animator);
+#if defined(SELF_CHECK_ALLOCATIONS)
+//allocations so far through the operator new AllocationCounter.cpp replaces. that replaces the allocator of the
+//whole program, so it only exists in self-check builds, the ones that define SELF_CHECK_ALLOCATIONS
+unsigned long long getAllocationCount();
+//boneTransform into a caller palette and update of an instance, on every clip, must not allocate once warmed up
+bool checkPaletteAllocations(const Animator &animator);
+#endif
+//skinDualQuat against skinLinear on rigid bones, random ones and the model's palettes: one bone per vertex, or the
+//same bone split across the four slots with its dual quaternion negated in some, which the hemisphere flip must undo
+bool checkDualQuatSkinning(const Animator &animator);
+//boneTransform's affine palettes against the hierarchy composed the way it was before, from translate, mat4_cast
+//and scale 4x4s. baked clips are compared on their frames, where baking adds no error of its own
+bool checkAffinePalette(const Animator &animator);
+//the crowd updates, Animator's batch, AnimationScheduler, AnimationPipeline and AnimationLod, at 1, 2, 4 and 8 threads
+//against the same instances updated one at a time, part of them bound to a pose cache. palettes have to match bit
+//for bit. this is also the workload to run under a thread sanitizer build
+bool checkBatchDeterminism(const Animator &animator);
+
+//runs every check, prints a summary and returns whether all of them passed
+bool runSelfChecks(Model &model);
+
+#endif
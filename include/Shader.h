@@ -10,7 +10,8 @@
 
 class Shader {
 public:
-	Shader(const char *vPath, const char *fPath);
+	//defines go right after the #version line of the vertex shader
+	Shader(const char *vPath, const char *fPath, const std::string &defines = "");
 	void use();
 
 	unsigned int id;
@@ -19,6 +20,8 @@ public:
 	void setBool(const std::string &name, bool value) const;
 	void setVec3(const std::string &name, glm::vec3 value) const;
 	void setMat4(const std::string &name, glm::mat4 value) const;
+	//points the uniform block called name at a buffer binding point
+	void setBlock(const std::string &name, unsigned int binding) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "Mesh.h"
+#include "Affine.h"
+#include "ModelCache.h"
+
+#include <glm/glm.hpp>
+
+#include <assimp/scene.h>
+
+struct BoneInfo {
+	Affine offset;
+};
+
+//flattened node of the scene hierarchy, parents always come before their children
+struct Joint {
+	int parent;
+	Affine bindLocal;
+	int boneId;
+};
+
+//joint hierarchy and bone offsets of a loaded model, shared by every instance of it
+class Skeleton {
+private:
+	std::vector<Joint> joints;
+	std::vector<std::string> jointNames;
+	std::map<std::string, unsigned int> jointMap;
+
+	std::map<std::string, unsigned int> boneMap;
+	std::vector<BoneInfo> boneInfo;
+
+	void flattenHierarchy(const aiNode* node, int parent);
+public:
+	Skeleton(const aiNode* root);
+	//reads back a skeleton stored with write, bones included
+	Skeleton(CacheReader &reader);
+	void write(CacheWriter &writer) const;
+	void loadBones(unsigned int meshId, const aiMesh* mesh, std::vector<VertexBoneData> &bones, const std::vector<unsigned int> &baseVertex);
+
+	unsigned int getNumJoints() const;
+	const Joint& getJoint(unsigned int jointId) const;
+	const std::string& getJointName(unsigned int jointId) const;
+	//returns the joint called name, or -1 when there is none
+	int findJoint(const std::string &name) const;
+
+	unsigned int getNumBones() const;
+	const BoneInfo& getBone(unsigned int boneId) const;
+};
+
+#endif
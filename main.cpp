@@ -1,4 +1,5 @@
 #include <iostream>
+#include <string>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -7,6 +8,10 @@
 
 #include "Shader.h"
 #include "Model.h"
+#include "ModelLoader.h"
+#include "AnimationPipeline.h"
+#include "SelfCheck.h"
+#include "Bench.h"
 #include "stb_image.h"
 
 const unsigned int winWidth = 1080;
@@ -16,7 +21,7 @@ const char title[] = "assimpAnimationProject";
 void fbSizeCallback(GLFWwindow* window, int w, int h);
 void handleInput(GLFWwindow* window);
 
-int main() {
+int main(int argc, char** argv) {
 	//initializing GLFW
 	if (!glfwInit()) {
 		std::cout << "Could not init GLFW." << std::endl;
@@ -42,8 +47,67 @@ int main() {
 
 	stbi_set_flip_vertically_on_load(true);
 
-	Shader shader("shaders/vertexShader.vs", "shaders/fragmentShader.fs");
-	Model model("models/boblampclean.md5mesh");
+	//--import-profile=<fast-load|runtime-optimal|editor> picks how assimp processes the model
+	//--bench-instancing compares one draw per character against instanced drawing, then exits
+	//--stream=<path> loads a second model in the background while the first one plays, and draws it beside it
+	//--self-check compares the optimised animation paths against their reference ones, then exits with 1 on a failure
+	//--bench-load times the cpu stage of loading generated scenes of 6, 60 and 600 meshes on one thread and on all, then exits
+	//--bench-keys times forward playback of tracks of 100, 1k and 10k keys with key cursors against a scan from the start
+	//--bench-pose-cache reports the pose cache's hit rate and cost on crowds in step and out of step, then exits
+	//--bench-skinning compares the palette upload size and per-vertex cost of linear blend and dual quaternion skinning
+	bool benchInstancing = false;
+	bool benchLoading = false;
+	bool benchKeys = false;
+	bool benchSkinning = false;
+	bool benchPoseCache = false;
+	bool selfCheck = false;
+	std::string streamPath;
+	JobSystem jobs;
+	ModelSettings settings;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--bench-instancing")
+			benchInstancing = true;
+		else if (arg == "--self-check")
+			selfCheck = true;
+		else if (arg == "--bench-load")
+			benchLoading = true;
+		else if (arg == "--bench-keys")
+			benchKeys = true;
+		else if (arg == "--bench-skinning")
+			benchSkinning = true;
+		else if (arg == "--bench-pose-cache")
+			benchPoseCache = true;
+		else if (arg.compare(0, 9, "--stream=") == 0)
+			streamPath = arg.substr(9);
+		else if (arg.compare(0, 17, "--import-profile=") == 0 && !parseImportProfile(arg.substr(17), settings.profile))
+			std::cout << "Unknown import profile: " << arg.substr(17) << std::endl;
+	}
+	if (benchLoading || benchKeys || benchSkinning) {
+		if (benchLoading)
+			benchmarkLoading();
+		if (benchKeys)
+			benchmarkKeys();
+		if (benchSkinning)
+			benchmarkSkinning();
+		glfwTerminate();
+		return 0;
+	}
+
+	settings.jobs = &jobs;
+	settings.releaseCpuGeometry = true;
+	//baked clips give the checks of the baked paths something to compare
+	if (selfCheck && settings.bakeRate <= 0.0f)
+		settings.bakeRate = 30.0f;
+	//linear blend palettes go through the model's persistently mapped ring and are read by offset,
+	//dual quaternion ones through the Palette uniform block
+	const bool streamPalettes = settings.skinning == SKINNING_LINEAR;
+	const char* vertexShader = streamPalettes ? "shaders/vertexShaderInstanced.vs" : "shaders/vertexShaderDQ.vs";
+
+	//the model comes first so the palette block of the shader can be sized from its skeleton
+	Model model("models/boblampclean.md5mesh", settings);
+	Shader shader(vertexShader, "shaders/fragmentShader.fs", model.getShaderDefines());
+	shader.setBlock("Palette", PALETTE_BLOCK_BINDING);
 
 	//setting up PVM matrices
 	glm::mat4 modelM = glm::mat4(1.0f);
@@ -61,6 +125,41 @@ int main() {
 	shader.setMat4("view", view);
 	shader.setMat4("projection", projection);
 
+	if (selfCheck) {
+		bool passed = runSelfChecks(model);
+		glfwTerminate();
+		return passed ? 0 : 1;
+	}
+
+	if (benchInstancing) {
+		benchmarkInstancing(window, model, view, projection);
+		glfwTerminate();
+		return 0;
+	}
+
+	if (benchPoseCache) {
+		benchmarkPoseCache(model);
+		glfwTerminate();
+		return 0;
+	}
+
+	//the next frame's pose is evaluated on a worker while this one is submitted
+	const bool pipelinedAnimation = true;
+	AnimationPipeline pipeline(model.getAnimator(), jobs);
+	AnimationInstance character = model.createInstance();
+	float lastTime = (float)glfwGetTime();
+	if (pipelinedAnimation)
+		pipeline.begin(&character, &lastTime, 1);
+
+	//the streamed model gets at most this much of every frame for its gl uploads
+	const size_t streamFrameBytes = 1024 * 1024;
+	const double streamFrameMillis = 2.0;
+	ModelLoader loader;
+	ModelHandle streamed;
+	AnimationInstance streamedCharacter;
+	glm::mat4 streamedM = glm::translate(glm::mat4(1.0f), glm::vec3(40.0f, 0.0f, 0.0f));
+	if (!streamPath.empty())
+		streamed = loader.load(streamPath, settings);
 
 	glfwSwapInterval(1);
 	glEnable(GL_DEPTH_TEST);
@@ -69,12 +168,53 @@ int main() {
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		model.draw(shader);
-		model.playAnimation(glfwGetTime(), shader);
+		float time = (float)glfwGetTime();
+		const Affine* palette = NULL;
+		if (pipelinedAnimation) {
+			palette = pipeline.end();
+
+			//aim the pose in flight at when it will be shown, a frame from now
+			float nextTime = time + (time - lastTime);
+			pipeline.begin(&character, &nextTime, 1);
+		}
+		else {
+			model.getAnimator().update(character, time);
+			palette = character.palette.empty() ? NULL : &character.palette[0];
+		}
+		lastTime = time;
+
+		shader.use();
+		if (streamPalettes) {
+			if (palette)
+				model.drawInstanced(shader, palette, &modelM, 1);
+			else
+				model.drawInstanced(shader, &character, &modelM, 1);
+		}
+		else {
+			if (palette)
+				model.uploadPalette(palette);
+			model.draw(shader);
+		}
+
+		if (streamed.isValid() && streamed.getState() != MODEL_RESIDENT) {
+			const UploadReport &upload = loader.update(streamFrameBytes, streamFrameMillis);
+			if (streamed.get()) {
+				std::cout << "Streamed model resident, last frame uploaded " << upload.bytes / 1024 << " KB in " << upload.millis << " ms" << std::endl;
+				streamedCharacter = streamed.get()->createInstance();
+			}
+		}
+		//the instanced shader reads the palette by offset, so the streamed model needs no shader of its own
+		if (streamed.get() && streamPalettes) {
+			streamed.get()->getAnimator().update(streamedCharacter, time);
+			streamed.get()->drawInstanced(shader, &streamedCharacter, &streamedM, 1);
+		}
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
+
+	if (pipelinedAnimation)
+		pipeline.end();
 }
 
 void fbSizeCallback(GLFWwindow * window, int w, int h) {
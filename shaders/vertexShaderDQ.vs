@@ -0,0 +1,45 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in vec3 aTangent;
+layout(location = 4) in vec3 aBitangent;
+layout(location = 5) in ivec4 boneIds;
+layout(location = 6) in vec4 weights;
+
+uniform mat4 projection, view, model;
+
+out vec2 texCoord;
+
+//sized by the application from the loaded skeleton, see Model::getShaderDefines
+#ifndef MAX_BONES
+#define MAX_BONES 100
+#endif
+//each bone is a unit dual quaternion, column 0 the real part and column 1 the dual part, both xyzw
+layout(std140) uniform Palette {
+	mat2x4 bones[MAX_BONES];
+};
+
+void main(){
+	mat2x4 dq0 = bones[boneIds[0]];
+	mat2x4 blended = dq0 * weights[0];
+
+	//blend every bone in the hemisphere of the first one so opposite rotations don't cancel out
+	for (int i = 1; i < 4; i++) {
+		mat2x4 dq = bones[boneIds[i]];
+		float hemisphere = dot(dq0[0], dq[0]) < 0.0 ? -1.0 : 1.0;
+		blended += dq * (weights[i] * hemisphere);
+	}
+
+	float len = length(blended[0]);
+	vec4 real = blended[0] / len;
+	vec4 dual = blended[1] / len;
+
+	vec3 position = aPos + 2.0 * cross(real.xyz, cross(real.xyz, aPos) + real.w * aPos);
+	position += 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+
+	texCoord = aTexCoord;
+
+	gl_Position = projection * view * model * vec4(position, 1.0);
+}
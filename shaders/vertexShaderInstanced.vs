@@ -0,0 +1,39 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in vec3 aTangent;
+layout(location = 4) in vec3 aBitangent;
+layout(location = 5) in ivec4 boneIds;
+layout(location = 6) in vec4 weights;
+
+uniform mat4 projection, view;
+
+out vec2 texCoord;
+
+//from texel paletteBase on, every instance is paletteStride texels: its model matrix, then its bones,
+//each one the top three rows of an affine matrix in three RGBA32F texels
+uniform samplerBuffer palettes;
+uniform int paletteBase;
+uniform int paletteStride;
+
+mat3x4 fetchAffine(int texel) {
+	return mat3x4(texelFetch(palettes, texel), texelFetch(palettes, texel + 1), texelFetch(palettes, texel + 2));
+}
+
+void main(){
+	int base = paletteBase + gl_InstanceID * paletteStride;
+	int bones = base + 3;
+
+	mat3x4 boneTransform = fetchAffine(bones + boneIds[0] * 3) * weights[0];
+	boneTransform += fetchAffine(bones + boneIds[1] * 3) * weights[1];
+	boneTransform += fetchAffine(bones + boneIds[2] * 3) * weights[2];
+	boneTransform += fetchAffine(bones + boneIds[3] * 3) * weights[3];
+
+	texCoord = aTexCoord;
+
+	vec3 skinned = vec4(aPos, 1.0) * boneTransform;
+	vec3 world = vec4(skinned, 1.0) * fetchAffine(base);
+	gl_Position = projection * view * vec4(world, 1.0);
+}
@@ -0,0 +1,30 @@
+#include "SelfCheck.h"
+
+#if defined(SELF_CHECK_ALLOCATIONS)
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+//on its own so nothing here allocates, every allocation of a self-check build goes through these
+std::atomic<unsigned long long> allocationCount(0);
+
+void* operator new(std::size_t size) {
+	allocationCount++;
+	void* p = std::malloc(size > 0 ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+unsigned long long getAllocationCount() {
+	return allocationCount;
+}
+#endif
@@ -0,0 +1,93 @@
+#include "AnimationLod.h"
+
+#include <algorithm>
+#include <cmath>
+
+//interpolating is far cheaper than evaluating, so jobs take more instances than Animator's batches
+const unsigned int LOD_JOB_INSTANCES = 64;
+
+AnimationLod::AnimationLod(const LodSettings &settings) {
+	this->settings = settings;
+}
+
+unsigned int AnimationLod::tierForDistance(float distance) const {
+	unsigned int tier = 0;
+	while (tier < LOD_NUM_TIERS - 1 && distance > settings.distances[tier])
+		tier++;
+
+	return tier;
+}
+
+bool loopsBetween(const Animator &animator, unsigned int clipId, float fromSeconds, float toSeconds) {
+	if (clipId >= animator.getNumClips())
+		return false;
+
+	const Clip& clip = animator.getClip(clipId);
+	if (clip.duration <= 0.0)
+		return false;
+
+	//playback wraps with fmod on the clip's length, a different whole number of lengths means it went round
+	double length = clip.duration / clip.ticksPerSecond;
+	return std::floor(fromSeconds / length) != std::floor(toSeconds / length);
+}
+
+LodReport AnimationLod::update(const Animator &animator, AnimationInstance* instances, const float* timesInSeconds, const float* distances, unsigned int numInstances, JobSystem &jobs) {
+	LodReport report;
+	due.resize(numInstances);
+	for (unsigned int i = 0; i < numInstances; i++) {
+		unsigned int tier = tierForDistance(distances[i]);
+		unsigned int interval = 1u << tier;
+
+		//staggered by index, so each frame updates about 1/interval of the tier
+		due[i] = (frame + i) % interval == 0 || instances[i].lodFrom.empty();
+		instances[i].lodTier = tier;
+		report.instances[tier]++;
+		report.evaluated += due[i];
+	}
+	frame++;
+
+	forEachInstance(instances, NULL, numInstances, LOD_JOB_INSTANCES, jobs, [this, &animator, instances, timesInSeconds](unsigned int i) {
+		AnimationInstance& instance = instances[i];
+		float time = timesInSeconds[i];
+		bool knownFrameTime = instance.lodFrameTime >= 0.0f;
+		float frameTime = time - instance.lodFrameTime;
+		instance.lodFrameTime = time;
+
+		if (instance.lodTier == 0 || instance.palette.empty()) {
+			animator.update(instance, time);
+			instance.lodFrom.clear();
+			return;
+		}
+
+		//nothing to blend from yet, so this frame is exact and the due update below opens the first window from it.
+		//before any frame time is known there is no telling how far ahead that window reaches, the next frame opens it
+		if (instance.lodFrom.empty()) {
+			animator.update(instance, time);
+			if (!knownFrameTime)
+				return;
+			instance.lodTo.resize(instance.palette.size());
+		}
+		//this frame's pose comes from the window set up on the last due frame, due frames included, so the
+		//drawn pose never lags. a window the clip loops in would blend its end into its start, it is evaluated instead
+		else if (instance.lodWraps)
+			animator.update(instance, time);
+		else {
+			float span = instance.lodToTime - instance.lodFromTime;
+			float factor = span > 0.0f ? glm::clamp((time - instance.lodFromTime) / span, 0.0f, 1.0f) : 1.0f;
+			for (unsigned int bone = 0; bone < instance.palette.size(); bone++) {
+				instance.palette[bone] = affineMix(instance.lodFrom[bone], instance.lodTo[bone], factor);
+			}
+		}
+
+		if (due[i]) {
+			instance.lodFrom = instance.palette;
+			instance.lodFromTime = time;
+			instance.lodToTime = time + (1u << instance.lodTier) * std::max(frameTime, 0.0f);
+			instance.time = time;
+			animator.boneTransform(instance, instance.lodToTime, &instance.lodTo[0], (unsigned int)instance.lodTo.size());
+			instance.lodWraps = loopsBetween(animator, instance.clip, instance.lodFromTime, instance.lodToTime);
+		}
+	});
+
+	return report;
+}
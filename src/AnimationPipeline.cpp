@@ -0,0 +1,108 @@
+#include "AnimationPipeline.h"
+
+#include <algorithm>
+#include <chrono>
+
+//same job size as Animator's batches, about 1000 joints of a 33 bone character
+const unsigned int PIPELINE_JOB_INSTANCES = 32;
+
+AnimationPipeline::AnimationPipeline(const Animator &animator, JobSystem &jobs) : animator(animator), jobs(jobs) {
+	numBones = animator.getNumBones();
+	worker = std::thread(&AnimationPipeline::workerLoop, this);
+}
+
+AnimationPipeline::~AnimationPipeline() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	worker.join();
+}
+
+void AnimationPipeline::begin(AnimationInstance* instances, const float* timesInSeconds, unsigned int numInstances) {
+	assert(!pending);
+	pending = true;
+
+	this->instances = instances;
+	this->times.assign(timesInSeconds, timesInSeconds + numInstances);
+	this->numInstances = numInstances;
+	palettes[1 - front].resize((size_t)numInstances * numBones);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		submitted++;
+	}
+	wake.notify_one();
+}
+
+const Affine* AnimationPipeline::end() {
+	if (!pending)
+		return palettes[front].empty() ? NULL : &palettes[front][0];
+	pending = false;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]() { return completed == submitted; });
+	}
+	waitMicros = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+	front = 1 - front;
+	return palettes[front].empty() ? NULL : &palettes[front][0];
+}
+
+bool AnimationPipeline::inFlight() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return completed != submitted;
+}
+
+void AnimationPipeline::workerLoop() {
+	unsigned long long fence = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this, fence]() { return quit || submitted != fence; });
+			if (quit)
+				return;
+			fence = submitted;
+		}
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		evaluate();
+		evaluateMicros = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			completed = fence;
+		}
+		done.notify_one();
+	}
+}
+
+void AnimationPipeline::evaluate() {
+	//nothing to write into, like end() an empty back buffer hands out no palettes
+	if (numBones == 0 || numInstances == 0 || palettes[1 - front].empty())
+		return;
+
+	Affine* back = &palettes[1 - front][0];
+	forEachInstance(instances, NULL, numInstances, PIPELINE_JOB_INSTANCES, jobs, [this, back](unsigned int i) {
+		animator.boneTransform(instances[i], times[i], back + (size_t)i * numBones, numBones);
+	});
+
+	for (unsigned int i = 0; i < numInstances; i++) {
+		instances[i].time = times[i];
+	}
+}
+
+unsigned int AnimationPipeline::getNumBones() const {
+	return numBones;
+}
+
+double AnimationPipeline::getEvaluateMicros() const {
+	return evaluateMicros;
+}
+
+double AnimationPipeline::getWaitMicros() const {
+	return waitMicros;
+}
@@ -0,0 +1,74 @@
+#include "AnimationScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+//instances evaluated on the first frame, before there is a cost estimate
+const unsigned int SCHEDULER_PROBE = 64;
+//about 1000 joints of a 33 bone character per job, like Animator's batches
+const unsigned int SCHEDULER_JOB_INSTANCES = 32;
+//weight of the newest frame in the cost estimate
+const double SCHEDULER_SMOOTHING = 0.2;
+
+AnimationScheduler::AnimationScheduler(const SchedulerSettings &settings) {
+	this->settings = settings;
+}
+
+SchedulerReport AnimationScheduler::update(const Animator &animator, AnimationInstance* instances, const float* timesInSeconds, const float* screenSizes, unsigned int numInstances, JobSystem &jobs) {
+	SchedulerReport report;
+	if (numInstances == 0)
+		return report;
+
+	importance.resize(numInstances);
+	order.resize(numInstances);
+	for (unsigned int i = 0; i < numInstances; i++) {
+		float staleness = std::max(timesInSeconds[i] - instances[i].time, 0.0f);
+		importance[i] = screenSizes[i] * staleness;
+		order[i] = i;
+	}
+
+	unsigned int count = SCHEDULER_PROBE;
+	if (microsPerInstance > 0.0)
+		count = (unsigned int)std::min(settings.budgetMicros / microsPerInstance, (double)numInstances);
+	count = std::min(std::max(count, settings.minUpdates), numInstances);
+
+	//only the split matters, the chosen ones are evaluated in parallel anyway.
+	//with minUpdates at 0 a tight budget can leave nothing to evaluate this frame
+	if (count > 0) {
+		std::nth_element(order.begin(), order.begin() + (count - 1), order.end(), [this](unsigned int a, unsigned int b) {
+			return importance[a] > importance[b];
+		});
+	}
+
+	for (unsigned int i = 0; i < numInstances; i++) {
+		unsigned int instance = order[i];
+		float latency = std::max(timesInSeconds[instance] - instances[instance].time, 0.0f);
+		if (i < count) {
+			report.averageLatency += latency;
+			report.maxLatency = std::max(report.maxLatency, latency);
+		}
+		else
+			report.maxDeferredLatency = std::max(report.maxDeferredLatency, latency);
+	}
+	report.evaluated = count;
+	report.deferred = numInstances - count;
+	if (count == 0)
+		return report;
+	report.averageLatency /= count;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	forEachInstance(instances, order.data(), count, SCHEDULER_JOB_INSTANCES, jobs, [&animator, instances, timesInSeconds](unsigned int i) {
+		animator.update(instances[i], timesInSeconds[i]);
+	});
+	report.spentMicros = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+	double micros = report.spentMicros / count;
+	microsPerInstance = microsPerInstance > 0.0 ? microsPerInstance + (micros - microsPerInstance) * SCHEDULER_SMOOTHING : micros;
+
+	report.overshootMicros = std::max(report.spentMicros - settings.budgetMicros, 0.0);
+	return report;
+}
+
+double AnimationScheduler::getMicrosPerInstance() const {
+	return microsPerInstance;
+}
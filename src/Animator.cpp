@@ -1,204 +1,250 @@
 #include "Animator.h"
 
+#include <algorithm>
+#include <chrono>
+
 glm::mat4 castMat4(const aiMatrix4x4 &mat);
 glm::quat castQuat(const aiQuaternion &quat);
 
+//joints evaluated per job, a 33 bone character is ~30 instances per job so scheduling stays a small fraction of the work
+const unsigned int JOB_JOINTS = 1024;
+
+//scratch of the hierarchy walk, per thread so const evaluation can run from several at once
+thread_local std::vector<Affine> globalTransforms;
+thread_local std::vector<float> localPose;
+
 Animator::Animator(const aiScene *scene) {
-	this->scene = scene;
-	globalITransform = glm::inverse(castMat4(scene->mRootNode->mTransformation));
-}
-
-void Animator::loadBones(unsigned int meshId, const aiMesh* mesh, std::vector<VertexBoneData> &bones, std::vector<unsigned int> baseVertex) {
-	for (unsigned int i = 0; i < mesh->mNumBones; i++) {
-		unsigned int boneId = 0;
-		std::string boneName(mesh->mBones[i]->mName.data);
-		if (boneMap.find(boneName) == boneMap.end()) {
-			boneId = numBones;
-			numBones++;
-			BoneInfo bi;
-			boneInfo.push_back(bi);
-			boneMap[boneName] = boneId;
-			boneInfo[boneId].offset = castMat4(mesh->mBones[i]->mOffsetMatrix);
-		}
-		else {
-			boneId = boneMap[boneName];
-		}
+	skeleton = std::make_shared<Skeleton>(scene->mRootNode);
+	clips = std::make_shared<ClipSet>(scene, *skeleton);
+}
 
-		for (unsigned int j = 0; j < mesh->mBones[i]->mNumWeights; j++) {
-			unsigned int vertexId = baseVertex[meshId] + mesh->mBones[i]->mWeights[j].mVertexId;
-			float weight = mesh->mBones[i]->mWeights[j].mWeight;
-			bones[vertexId].addBoneData(boneId, weight);
-		}
-	}
+Animator::Animator(CacheReader &reader) {
+	skeleton = std::make_shared<Skeleton>(reader);
+	clips = std::make_shared<ClipSet>(reader, *skeleton);
 }
 
-std::vector<glm::mat4> Animator::boneTransform(float timeInSeconds, std::vector<glm::mat4> transforms) {
-	glm::mat4 identity = glm::mat4(1.0f);
+void Animator::write(CacheWriter &writer) const {
+	skeleton->write(writer);
+	clips->write(writer);
+}
 
-	unsigned int numPosKeys = scene->mAnimations[0]->mChannels[0]->mNumPositionKeys;
-	double animDuration = scene->mAnimations[0]->mChannels[0]->mPositionKeys[numPosKeys - 1].mTime;
+void Animator::loadBones(unsigned int meshId, const aiMesh* mesh, std::vector<VertexBoneData> &bones, const std::vector<unsigned int> &baseVertex) {
+	skeleton->loadBones(meshId, mesh, bones, baseVertex);
+}
 
-	float ticksPerSecond = (float)(scene->mAnimations[0]->mTicksPerSecond != 0 ? scene->mAnimations[0]->mTicksPerSecond : 25.0f);
+AnimationInstance Animator::createInstance() const {
+	AnimationInstance instance;
+	instance.cursors.resize(clips->getMaxTracks());
+	instance.palette.resize(skeleton->getNumBones());
+	return instance;
+}
 
-	float timeInTicks = timeInSeconds * ticksPerSecond;
-	float animationTime = std::fmod(timeInTicks, animDuration);
-	
-	readNodeHeirarchy(animationTime, scene->mRootNode, identity);
-	transforms.resize(numBones);
+void Animator::update(AnimationInstance &instance, float timeInSeconds) const {
+	instance.time = timeInSeconds;
+	if (!instance.palette.empty())
+		boneTransform(instance, timeInSeconds, &instance.palette[0], (unsigned int)instance.palette.size());
+}
 
-	for (unsigned int i = 0; i < numBones; i++) {
-		transforms[i] = boneInfo[i].finalTransform;
-	}
+void Animator::update(AnimationInstance* instances, const float* timesInSeconds, unsigned int numInstances, JobSystem &jobs) const {
+	unsigned int grain = std::max(JOB_JOINTS / std::max(skeleton->getNumJoints(), 1u), 1u);
+	//but keep a few chunks per thread around to steal, or small crowds wouldn't spread out
+	grain = std::max(std::min(grain, numInstances / (jobs.getNumThreads() * 4)), 1u);
 
-	return transforms;
+	forEachInstance(instances, NULL, numInstances, grain, jobs, [this, instances, timesInSeconds](unsigned int i) {
+		update(instances[i], timesInSeconds[i]);
+	});
 }
 
-void Animator::readNodeHeirarchy(float animationTime, const aiNode* node, const glm::mat4& parentTransform) {
-	std::string nodeName(node->mName.data);
+void Animator::boneTransform(AnimationInstance &instance, float timeInSeconds, Affine* palette, unsigned int paletteSize) const {
+	unsigned int numBones = skeleton->getNumBones();
+	assert(paletteSize >= numBones);
 
-	const aiAnimation* animation = scene->mAnimations[0];
+	const Clip* clip = NULL;
+	float animationTime = 0.0f;
+	if (instance.clip < clips->getNumClips()) {
+		clip = &clips->getClip(instance.clip);
+		instance.cursors.resize(std::max(instance.cursors.size(), clip->tracks.size()));
+	}
 
-	glm::mat4 nodeTransformation = castMat4(node->mTransformation);
+	if (clip && clip->duration > 0.0) {
+		float timeInTicks = timeInSeconds * clip->ticksPerSecond;
+		animationTime = std::fmod(timeInTicks, (float)clip->duration);
 
-	const aiNodeAnim* nodeAnim = findNodeAnim(animation, nodeName);
+		if (clip->palettes.numFrames > 0) {
+			samplePalette(clip->palettes, animationTime, palette);
+			return;
+		}
 
-	if (nodeAnim) {
-		aiVector3D scaling;
-		calcInterpolatedScaling(scaling, animationTime, nodeAnim);
-		glm::vec3 scale = glm::vec3(scaling.x, scaling.y, scaling.z);
-		glm::mat4 scalingM = glm::scale(glm::mat4(1.0f), scale);
+		if (instance.poseCache) {
+			PoseCache* poseCache = instance.poseCache;
+			unsigned int sample = poseCache->quantize(animationTime / clip->ticksPerSecond);
+			PoseKey key = { skeleton.get(), instance.clip, sample };
+			if (poseCache->fetch(key, palette, paletteSize))
+				return;
 
-		aiQuaternion rotationQ;
-		calcInterpolatedRotation(rotationQ, animationTime, nodeAnim);
-		glm::quat rotation = castQuat(rotationQ);
-		glm::mat4 rotationM = glm::mat4_cast(rotation);
+			evaluatePose(clip, poseCache->sampleTime(sample) * clip->ticksPerSecond, instance.cursors.data(), palette);
+			poseCache->store(key, palette, numBones);
+			return;
+		}
+	}
 
-		aiVector3D translation;
-		calcInterpolatedPosition(translation, animationTime, nodeAnim);
-		glm::vec3 transVec = glm::vec3(translation.x, translation.y, translation.z);
-		glm::mat4 translationM = glm::translate(glm::mat4(1.0f), transVec);
+	evaluatePose(clip, animationTime, instance.cursors.data(), palette);
+}
 
-		nodeTransformation = translationM * rotationM * scalingM;
-	}
+unsigned int Animator::getNumBones() const {
+	return skeleton->getNumBones();
+}
 
-	glm::mat4 globalTransformation = parentTransform * nodeTransformation;
+unsigned int Animator::getNumClips() const {
+	return clips->getNumClips();
+}
 
-	if (boneMap.find(nodeName) != boneMap.end()) {
-		unsigned int boneId = boneMap[nodeName];
-		boneInfo[boneId].finalTransform = globalTransformation * boneInfo[boneId].offset;
-	}
+const Clip& Animator::getClip(unsigned int clipId) const {
+	return clips->getClip(clipId);
+}
 
-	for (unsigned int i = 0; i < node->mNumChildren; i++) {
-		readNodeHeirarchy(animationTime, node->mChildren[i], globalTransformation);
-	}
+int Animator::findClip(const std::string &name) const {
+	return clips->findClip(name);
 }
 
-unsigned int Animator::findScaling(float animationTime, const aiNodeAnim* nodeAnim) {
-	assert(nodeAnim->mNumScalingKeys > 0);
-	for (unsigned int i = 0; i < nodeAnim->mNumScalingKeys-1; i++) {
-		if (animationTime < (float)nodeAnim->mScalingKeys[i + 1].mTime) {
-			return i;
-		}
-	}
+std::shared_ptr<const Skeleton> Animator::getSkeleton() const {
+	return skeleton;
+}
 
-	assert(0);
-	return 0;
+std::shared_ptr<const ClipSet> Animator::getClipSet() const {
+	return clips;
 }
 
-unsigned int Animator::findRotation(float animationTime, const aiNodeAnim* nodeAnim) {
-	assert(nodeAnim->mNumRotationKeys > 0);
+void Animator::evaluatePose(const Clip* clip, float animationTime, KeyCursor* cursors, Affine* palette) const {
+	const BakedClip* baked = clip && clip->baked.numFrames > 0 ? &clip->baked : NULL;
+	unsigned int numJoints = skeleton->getNumJoints();
+	if (globalTransforms.size() < numJoints)
+		globalTransforms.resize(numJoints);
+
+	//a clip without tracks bakes to empty frames, every joint keeps its bind pose and nothing is sampled
+	if (baked && baked->stride > 0) {
+		//palette baking samples the clip's very end, which is the last frame, so interpolate into it instead
+		float frameTime = animationTime * baked->framesPerTick;
+		unsigned int frame = std::min((unsigned int)frameTime, baked->numFrames - 2);
+		unsigned int frameSize = POSE_NUM_STREAMS * baked->stride;
+		if (localPose.size() < frameSize)
+			localPose.resize(frameSize);
+
+		const float* current = &baked->samples[frame * frameSize];
+		samplePoseSimd(current, current + frameSize, frameTime - (float)frame, baked->stride, &localPose[0]);
+	}
+
+	for (unsigned int i = 0; i < numJoints; i++) {
+		const Joint& joint = skeleton->getJoint(i);
+		Affine nodeTransformation = joint.bindLocal;
+
+		int track = clip ? clip->jointTracks[i] : -1;
+		if (track >= 0) {
+			glm::vec3 scale, transVec;
+			glm::quat rotation;
+			if (baked)
+				readPose(&localPose[0], baked->stride, track, scale, rotation, transVec);
+			else
+				sampleTrack(clip->tracks[track], animationTime, cursors[track], scale, rotation, transVec);
 
-	for (unsigned int i = 0; i < nodeAnim->mNumRotationKeys-1; i++) {
-		if (animationTime < (float)nodeAnim->mRotationKeys[i + 1].mTime) {
-			return i;
+			nodeTransformation = affineFromTRS(transVec, rotation, scale);
 		}
-	}
 
-	assert(0);
-	return 0;
-}
+		if (joint.parent < 0)
+			globalTransforms[i] = nodeTransformation;
+		else
+			globalTransforms[i] = globalTransforms[joint.parent] * nodeTransformation;
 
-unsigned int Animator::findPosition(float animationTime, const aiNodeAnim* nodeAnim) {
-	for (unsigned int i = 0; i < nodeAnim->mNumPositionKeys - 1; i++) {
-		if (animationTime < (float)nodeAnim->mPositionKeys[i + 1].mTime) {
-			return i;
+		if (joint.boneId >= 0) {
+			palette[joint.boneId] = globalTransforms[i] * skeleton->getBone(joint.boneId).offset;
 		}
 	}
+}
 
-	assert(0);
-	return 0;
+BakeReport Animator::bake(float samplesPerSecond) {
+	return clips->bake(samplesPerSecond);
 }
 
-void Animator::calcInterpolatedScaling(aiVector3D& out, float animationTime, const aiNodeAnim* nodeAnim) {
-	if (nodeAnim->mNumScalingKeys == 1) {
-		out = nodeAnim->mScalingKeys[0].mValue;
-		return;
+PaletteBakeReport Animator::bakePalettes(float samplesPerSecond, size_t budgetBytes) {
+	PaletteBakeReport report;
+	unsigned int numBones = skeleton->getNumBones();
+	unsigned int numClips = clips->getNumClips();
+	if (samplesPerSecond <= 0.0f || numBones == 0)
+		return report;
+
+	std::vector<unsigned int> order(numClips);
+	std::vector<unsigned int> clipFrames(numClips);
+	for (unsigned int i = 0; i < numClips; i++) {
+		const Clip& clip = clips->getClip(i);
+		order[i] = i;
+		float framesPerTick = samplesPerSecond / clip.ticksPerSecond;
+		clipFrames[i] = std::max((unsigned int)std::ceil(clip.duration * framesPerTick), 1u) + 1;
 	}
+	std::stable_sort(order.begin(), order.end(), [&clipFrames](unsigned int a, unsigned int b) {
+		return clipFrames[a] < clipFrames[b];
+	});
+
+	std::vector<Affine> pose(numBones);
+	std::vector<KeyCursor> cursors(clips->getMaxTracks());
+	std::chrono::duration<double, std::micro> evaluateTime(0), lookupTime(0);
+	unsigned int numPoses = 0;
+
+	for (unsigned int i = 0; i < order.size(); i++) {
+		const Clip& clip = clips->getClip(order[i]);
+		size_t bytes = (size_t)clipFrames[order[i]] * numBones * sizeof(Affine);
+		if (report.bytes + bytes > budgetBytes) {
+			report.clipsSkipped++;
+			continue;
+		}
 
-	unsigned int scalingIndex = findScaling(animationTime, nodeAnim);
-	unsigned int nextScalingIndex = (scalingIndex + 1);
-	assert(nextScalingIndex < nodeAnim->mNumScalingKeys);
-
-	float deltaTime = (float)(nodeAnim->mScalingKeys[nextScalingIndex].mTime - nodeAnim->mScalingKeys[scalingIndex].mTime);
-	float factor = (animationTime - (float)nodeAnim->mScalingKeys[scalingIndex].mTime) / deltaTime;
-	assert(factor >= 0.0f && factor >= 1.0f);
+		BakedPalette palettes;
+		palettes.framesPerTick = samplesPerSecond / clip.ticksPerSecond;
+		palettes.numFrames = clipFrames[order[i]];
+		palettes.matrices.resize(palettes.numFrames * numBones);
 
-	const aiVector3D& start = nodeAnim->mScalingKeys[scalingIndex].mValue;
-	const aiVector3D& end = nodeAnim->mScalingKeys[nextScalingIndex].mValue;
-	aiVector3D delta = end - start;
-	out = start + factor * delta;
-}
+		for (unsigned int frame = 0; frame < palettes.numFrames; frame++) {
+			float animationTime = std::min((float)frame / palettes.framesPerTick, (float)clip.duration);
 
-void Animator::calcInterpolatedRotation(aiQuaternion& out, float animationTime, const aiNodeAnim* nodeAnim) {
-	if (nodeAnim->mNumRotationKeys == 1) {
-		out = nodeAnim->mRotationKeys[0].mValue;
-		return;
-	}
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			evaluatePose(&clip, animationTime, cursors.data(), &pose[0]);
+			evaluateTime += std::chrono::high_resolution_clock::now() - start;
 
-	unsigned int rotationIndex = findRotation(animationTime, nodeAnim);
-	unsigned int nextRotationIndex = (rotationIndex + 1);
-	assert(nextRotationIndex < nodeAnim->mNumRotationKeys);
-	
-	float deltaTime = (float)(nodeAnim->mRotationKeys[nextRotationIndex].mTime - nodeAnim->mRotationKeys[rotationIndex].mTime);
-	float factor = (animationTime - (float)nodeAnim->mRotationKeys[rotationIndex].mTime) / deltaTime;
-	assert(factor >= 0.0f && factor <= 1.0f);
+			for (unsigned int bone = 0; bone < numBones; bone++)
+				palettes.matrices[frame * numBones + bone] = pose[bone];
+		}
 
-	const aiQuaternion& start = nodeAnim->mRotationKeys[rotationIndex].mValue;
-	const aiQuaternion& end = nodeAnim->mRotationKeys[nextRotationIndex].mValue;
-	aiQuaternion::Interpolate(out, start, end, factor);
-	out = out.Normalize();
-}
+		for (unsigned int frame = 0; frame + 1 < palettes.numFrames; frame++) {
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			samplePalette(palettes, ((float)frame + 0.5f) / palettes.framesPerTick, &pose[0]);
+			lookupTime += std::chrono::high_resolution_clock::now() - start;
+		}
 
-void Animator::calcInterpolatedPosition(aiVector3D& out, float animationTime, const aiNodeAnim* nodeAnim) {
-	if (nodeAnim->mNumPositionKeys == 1) {
-		out = nodeAnim->mPositionKeys[0].mValue;
-		return;
+		numPoses += palettes.numFrames;
+		report.bytes += bytes;
+		report.clipsBaked++;
+		clips->setPalettes(order[i], palettes);
 	}
-	
-	unsigned int positionIndex = findPosition(animationTime, nodeAnim);
-	unsigned int nextPositionIndex = (positionIndex + 1);
-	assert(nextPositionIndex < nodeAnim->mNumPositionKeys);
 
-	float deltaTime = (float)(nodeAnim->mPositionKeys[nextPositionIndex].mTime - nodeAnim->mPositionKeys[positionIndex].mTime);
-	float factor = (animationTime - (float)nodeAnim->mPositionKeys[positionIndex].mTime) / deltaTime;
-	assert(factor >= 0.0f && factor <= 1.0f);
+	if (numPoses > 0) {
+		report.evaluateMicros = evaluateTime.count() / numPoses;
+		report.lookupMicros = lookupTime.count() / std::max(numPoses - report.clipsBaked, 1u);
+	}
 
-	const aiVector3D& start = nodeAnim->mPositionKeys[positionIndex].mValue;
-	const aiVector3D& end = nodeAnim->mPositionKeys[nextPositionIndex].mValue;
-	aiVector3D delta = end - start;
-	out = start + factor * delta;
+	return report;
 }
 
-const aiNodeAnim* Animator::findNodeAnim(const aiAnimation* animation, const std::string nodeName) {
-	for (unsigned int i = 0; i < animation->mNumChannels; i++) {
-		const aiNodeAnim* nodeAnim = animation->mChannels[i];
+void Animator::samplePalette(const BakedPalette &palettes, float animationTime, Affine* palette) const {
+	unsigned int numBones = skeleton->getNumBones();
+	float frameTime = animationTime * palettes.framesPerTick;
+	//the clip's end rounds onto the last frame, which has no next one, so interpolate into it as evaluatePose does
+	unsigned int frame = std::min((unsigned int)frameTime, palettes.numFrames - 2);
+	float factor = frameTime - (float)frame;
 
-		if (std::string(nodeAnim->mNodeName.data) == nodeName) {
-			return nodeAnim;
-		}
+	const Affine* current = &palettes.matrices[frame * numBones];
+	const Affine* next = current + numBones;
+	for (unsigned int i = 0; i < numBones; i++) {
+		palette[i] = affineMix(current[i], next[i], factor);
 	}
-
-	return NULL;
 }
 
 glm::mat4 castMat4(const aiMatrix4x4& mat) {
@@ -207,4 +253,4 @@ glm::mat4 castMat4(const aiMatrix4x4& mat) {
 
 glm::quat castQuat(const aiQuaternion& quat) {
 	return glm::quat(quat.w, quat.x, quat.y, quat.z);
-}
\ No newline at end of file
+}
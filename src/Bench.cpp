@@ -0,0 +1,331 @@
+#include "Bench.h"
+#include "SelfCheck.h"
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <cstdio>
+#include <random>
+
+void benchmarkInstancing(GLFWwindow* window, Model& model, const glm::mat4& view, const glm::mat4& projection) {
+	if (model.getSkinningMode() != SKINNING_LINEAR) {
+		std::cout << "Instanced drawing needs linear blend skinning." << std::endl;
+		return;
+	}
+
+	Shader instancedShader("shaders/vertexShaderInstanced.vs", "shaders/fragmentShader.fs");
+	instancedShader.use();
+	instancedShader.setMat4("view", view);
+	instancedShader.setMat4("projection", projection);
+
+	const unsigned int counts[] = { 1, 16, 64, 256, 1024, 4096 };
+	const unsigned int numFrames = 30;
+	JobSystem jobs;
+	glfwSwapInterval(0);
+	glEnable(GL_DEPTH_TEST);
+
+	std::cout << "instances, draw calls per frame (per character / instanced), submit ms per frame (per character / instanced)" << std::endl;
+	for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		unsigned int count = counts[c];
+		std::vector<AnimationInstance> crowd(count, model.createInstance());
+		std::vector<glm::mat4> transforms(count);
+		std::vector<float> times(count);
+		unsigned int side = (unsigned int)std::ceil(std::sqrt((float)count));
+		for (unsigned int i = 0; i < count; i++) {
+			glm::vec3 offset((float)(i % side) - side * 0.5f, 0.0f, -(float)(i / side));
+			transforms[i] = glm::translate(glm::mat4(1.0f), offset * 40.0f);
+		}
+
+		unsigned int drawCalls[2];
+		double submitMillis[2];
+		for (unsigned int instanced = 0; instanced < 2; instanced++) {
+			model.resetDrawStats();
+			std::chrono::duration<double, std::milli> submitTime(0);
+
+			for (unsigned int frame = 0; frame < numFrames; frame++) {
+				for (unsigned int i = 0; i < count; i++)
+					times[i] = (float)glfwGetTime() + i * 0.1f;
+				model.getAnimator().update(&crowd[0], &times[0], count, jobs);
+
+				glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				//the same palette ring either way, per character every draw takes a region of its own
+				instancedShader.use();
+				if (instanced)
+					model.drawInstanced(instancedShader, &crowd[0], &transforms[0], count);
+				else {
+					for (unsigned int i = 0; i < count; i++)
+						model.drawInstanced(instancedShader, &crowd[i], &transforms[i], 1);
+				}
+				submitTime += std::chrono::high_resolution_clock::now() - start;
+
+				glfwSwapBuffers(window);
+				glfwPollEvents();
+			}
+
+			drawCalls[instanced] = model.getDrawStats().drawCalls / numFrames;
+			submitMillis[instanced] = submitTime.count() / numFrames;
+		}
+
+		std::cout << count << ", " << drawCalls[0] << " / " << drawCalls[1] << ", "
+			<< submitMillis[0] << " / " << submitMillis[1] << std::endl;
+	}
+}
+
+//crowds whose characters start on one of a few phases share poses, like a marching column, the others each have their own
+void benchmarkPoseCache(Model& model) {
+	const unsigned int counts[] = { 64, 256, 1024 };
+	const unsigned int phaseCounts[] = { 8, 0 }; //0 gives every character its own phase
+	const unsigned int numFrames = 300;
+	const float samplesPerSecond = 30.0f;
+	const unsigned int capacity = 64; //about two seconds of one clip
+	const Animator& animator = model.getAnimator();
+
+	std::cout << "instances, phases, pose cache hit rate, entries, KB, us per instance (cached / uncached)" << std::endl;
+	for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		for (unsigned int p = 0; p < sizeof(phaseCounts) / sizeof(phaseCounts[0]); p++) {
+			unsigned int count = counts[c];
+			unsigned int phases = phaseCounts[p] > 0 ? phaseCounts[p] : count;
+			std::vector<float> offsets(count);
+			for (unsigned int i = 0; i < count; i++)
+				offsets[i] = (float)(i % phases) * 0.173f;
+
+			PoseCache cache(capacity, samplesPerSecond);
+			double micros[2];
+			for (unsigned int mode = 0; mode < 2; mode++) {
+				std::vector<AnimationInstance> crowd(count, model.createInstance());
+				for (unsigned int i = 0; i < count; i++)
+					crowd[i].poseCache = mode == 0 ? &cache : NULL;
+
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				for (unsigned int frame = 0; frame < numFrames; frame++) {
+					for (unsigned int i = 0; i < count; i++)
+						animator.update(crowd[i], frame / 60.0f + offsets[i]);
+				}
+				micros[mode] = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / (numFrames * count);
+			}
+
+			unsigned long long lookups = cache.getHits() + cache.getMisses();
+			double hitRate = lookups > 0 ? (double)cache.getHits() / lookups : 0.0;
+			std::cout << count << ", " << (phaseCounts[p] > 0 ? std::to_string(phases) : "each own") << ", " << hitRate * 100.0 << "%, "
+				<< cache.getSize() << ", " << cache.getBytes() / 1024 << ", " << micros[0] << " / " << micros[1] << std::endl;
+		}
+	}
+}
+
+//writes an obj of numMeshes separate grids of gridSize by gridSize quads, each its own object so assimp keeps it a mesh
+void writeBenchmarkScene(const std::string &path, unsigned int numMeshes, unsigned int gridSize) {
+	std::ofstream file(path);
+	unsigned int firstVertex = 1;
+	for (unsigned int m = 0; m < numMeshes; m++) {
+		file << "o mesh" << m << "\n";
+		for (unsigned int y = 0; y <= gridSize; y++) {
+			for (unsigned int x = 0; x <= gridSize; x++) {
+				//a gentle bump so the normals and tangents have something to work out
+				float height = std::sin(x * 0.3f + m) * std::cos(y * 0.3f);
+				file << "v " << (float)x + m * (gridSize + 2.0f) << " " << height << " " << (float)y << "\n";
+				file << "vt " << (float)x / gridSize << " " << (float)y / gridSize << "\n";
+			}
+		}
+
+		for (unsigned int y = 0; y < gridSize; y++) {
+			for (unsigned int x = 0; x < gridSize; x++) {
+				unsigned int a = firstVertex + y * (gridSize + 1) + x;
+				unsigned int b = a + 1, c = a + gridSize + 1, d = c + 1;
+				file << "f " << a << "/" << a << " " << b << "/" << b << " " << d << "/" << d << " " << c << "/" << c << "\n";
+			}
+		}
+		firstVertex += (gridSize + 1) * (gridSize + 1);
+	}
+}
+
+void benchmarkLoading() {
+	const unsigned int meshCounts[] = { 6, 60, 600 };
+	const unsigned int gridSize = 32;
+	const unsigned int numRuns = 3;
+	JobSystem serialJobs(1);
+	JobSystem parallelJobs;
+
+	//the editor profile keeps every mesh, runtime-optimal would merge them into one. nothing is uploaded, the gl
+	//stage is the same whatever the thread count, and the cache is off so every run imports
+	ModelSettings settings;
+	settings.profile = IMPORT_EDITOR;
+	settings.useCache = false;
+
+	std::vector<std::string> results;
+	for (unsigned int c = 0; c < sizeof(meshCounts) / sizeof(meshCounts[0]); c++) {
+		std::string path = "bench_load_" + std::to_string(meshCounts[c]) + ".obj";
+		writeBenchmarkScene(path, meshCounts[c], gridSize);
+
+		//best of a few runs, for the load and for its mesh processing stage, on one thread then on every thread
+		double loadMillis[2] = { 1e30, 1e30 };
+		double stageMillis[2] = { 1e30, 1e30 };
+		for (unsigned int parallel = 0; parallel < 2; parallel++) {
+			settings.jobs = parallel ? &parallelJobs : &serialJobs;
+			for (unsigned int run = 0; run < numRuns; run++) {
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				Model model(path.c_str(), settings, false);
+				double millis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				loadMillis[parallel] = std::min(loadMillis[parallel], millis);
+				stageMillis[parallel] = std::min(stageMillis[parallel], model.getLoadTimes().cpuMillis);
+			}
+		}
+		std::remove(path.c_str());
+
+		results.push_back(std::to_string(meshCounts[c]) + ", " + std::to_string(loadMillis[0]) + " / " + std::to_string(loadMillis[1]) + ", "
+			+ std::to_string(stageMillis[0]) + " / " + std::to_string(stageMillis[1]) + ", " + std::to_string(stageMillis[0] / std::max(stageMillis[1], 0.001)) + "x");
+	}
+
+	//after the loads, whose own logging would otherwise be mixed into the table
+	std::cout << "meshes, load ms (1 thread / " << parallelJobs.getNumThreads() << " threads), mesh processing ms (1 / "
+		<< parallelJobs.getNumThreads() << "), mesh processing speedup" << std::endl;
+	for (unsigned int i = 0; i < results.size(); i++)
+		std::cout << results[i] << std::endl;
+}
+
+//how keys were found before the cursors: a walk from the first key until the next one is later
+template <typename Key>
+unsigned int scanKey(float animationTime, const std::vector<Key> &keys) {
+	for (unsigned int i = 0; i + 1 < keys.size(); i++) {
+		if (animationTime < keys[i + 1].time)
+			return i;
+	}
+	return (unsigned int)keys.size() - 2;
+}
+
+template <typename Key>
+float scanFactor(float animationTime, const std::vector<Key> &keys, unsigned int i) {
+	return glm::clamp((animationTime - keys[i].time) / (keys[i + 1].time - keys[i].time), 0.0f, 1.0f);
+}
+
+void benchmarkKeys() {
+	const unsigned int keyCounts[] = { 100, 1000, 10000 };
+	const unsigned int numFrames = 600; //ten seconds at 60 fps over the clip
+	const unsigned int numPasses = 50;
+
+	std::cout << "keys, us per sample (scan from the start / key cursor / cursor after a seek), scan to cursor speedup, max difference" << std::endl;
+	for (unsigned int c = 0; c < sizeof(keyCounts) / sizeof(keyCounts[0]); c++) {
+		unsigned int numKeys = keyCounts[c];
+		Track track;
+		for (unsigned int i = 0; i < numKeys; i++) {
+			float time = (float)i;
+			VectorKey scaling = { time, glm::vec3(1.0f + 0.1f * std::sin(time)) };
+			QuatKey rotation = { time, glm::angleAxis(time * 0.1f, glm::vec3(0.0f, 1.0f, 0.0f)) };
+			VectorKey position = { time, glm::vec3(time, std::cos(time), 0.0f) };
+			track.scalingKeys.push_back(scaling);
+			track.rotationKeys.push_back(rotation);
+			track.positionKeys.push_back(position);
+		}
+
+		std::vector<float> times(numFrames);
+		for (unsigned int f = 0; f < numFrames; f++)
+			times[f] = (float)f / numFrames * (numKeys - 1);
+
+		//the scan interpolates the same way sampleTrack does, so only the search differs
+		std::vector<glm::vec3> scanPositions(numFrames), cursorPositions(numFrames);
+		glm::vec3 scale, position;
+		glm::quat rotation;
+		double micros[3];
+		for (unsigned int mode = 0; mode < 3; mode++) {
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			for (unsigned int pass = 0; pass < numPasses; pass++) {
+				KeyCursor cursor;
+				for (unsigned int f = 0; f < numFrames; f++) {
+					float time = times[f];
+					if (mode == 0) {
+						unsigned int s = scanKey(time, track.scalingKeys);
+						unsigned int r = scanKey(time, track.rotationKeys);
+						unsigned int p = scanKey(time, track.positionKeys);
+						scale = glm::mix(track.scalingKeys[s].value, track.scalingKeys[s + 1].value, scanFactor(time, track.scalingKeys, s));
+						rotation = glm::normalize(glm::slerp(track.rotationKeys[r].value, track.rotationKeys[r + 1].value, scanFactor(time, track.rotationKeys, r)));
+						position = glm::mix(track.positionKeys[p].value, track.positionKeys[p + 1].value, scanFactor(time, track.positionKeys, p));
+						scanPositions[f] = position + scale + glm::vec3(rotation.x, rotation.y, rotation.z);
+					}
+					else {
+						//a seek leaves the cursor somewhere unrelated, so every sample falls back to the binary search
+						if (mode == 2)
+							cursor = KeyCursor();
+						sampleTrack(track, time, cursor, scale, rotation, position);
+						cursorPositions[f] = position + scale + glm::vec3(rotation.x, rotation.y, rotation.z);
+					}
+				}
+			}
+			micros[mode] = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / (numPasses * numFrames);
+		}
+
+		float difference = 0.0f;
+		for (unsigned int f = 0; f < numFrames; f++)
+			difference = std::max(difference, glm::length(scanPositions[f] - cursorPositions[f]));
+
+		std::cout << numKeys << ", " << micros[0] << " / " << micros[1] << " / " << micros[2] << ", "
+			<< micros[0] / std::max(micros[1], 1e-9) << "x, " << difference << std::endl;
+	}
+}
+
+//the per-vertex cost is timed on the cpu ports of the two vertex shaders, the gpu runs the same operations per vertex
+void benchmarkSkinning() {
+	const unsigned int boneCounts[] = { 33, 100, 256 };
+	const unsigned int numVertices = 1 << 20;
+	const unsigned int numPalettes = 1000;
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f), weight(0.05f, 1.0f);
+
+	std::cout << "bones, bytes per palette upload (mat4 / linear blend / dual quaternion), us per palette conversion to dual quaternions, "
+		<< "ns per vertex (linear blend / dual quaternion), max difference" << std::endl;
+	for (unsigned int c = 0; c < sizeof(boneCounts) / sizeof(boneCounts[0]); c++) {
+		unsigned int numBones = boneCounts[c];
+		std::vector<Affine> palette(numBones);
+		for (unsigned int i = 0; i < numBones; i++) {
+			glm::quat rotation = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+			palette[i] = affineFromTRS(glm::vec3(unit(random), unit(random), unit(random)) * 50.0f, rotation, glm::vec3(1.0f));
+		}
+
+		//what Model::uploadPalette adds per palette
+		std::vector<glm::dualquat> dualPalette(numBones);
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (unsigned int p = 0; p < numPalettes; p++) {
+			for (unsigned int i = 0; i < numBones; i++)
+				dualPalette[i] = affineToDualQuat(palette[(i + p) % numBones]);
+		}
+		double convertMicros = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / numPalettes;
+		for (unsigned int i = 0; i < numBones; i++)
+			dualPalette[i] = affineToDualQuat(palette[i]);
+
+		//neighbouring bones with weights that fall off, roughly how a rig's influences look
+		std::vector<glm::vec3> positions(numVertices);
+		std::vector<glm::ivec4> ids(numVertices);
+		std::vector<glm::vec4> weights(numVertices);
+		for (unsigned int v = 0; v < numVertices; v++) {
+			positions[v] = glm::vec3(unit(random), unit(random), unit(random)) * 20.0f;
+			unsigned int first = random() % numBones;
+			ids[v] = glm::ivec4(first, (first + 1) % numBones, (first + 2) % numBones, (first + 3) % numBones);
+			glm::vec4 w(1.0f, weight(random) * 0.5f, weight(random) * 0.2f, weight(random) * 0.1f);
+			weights[v] = w / (w.x + w.y + w.z + w.w);
+		}
+
+		std::vector<glm::vec3> skinned[2];
+		double nanos[2];
+		for (unsigned int mode = 0; mode < 2; mode++) {
+			skinned[mode].resize(numVertices);
+			start = std::chrono::high_resolution_clock::now();
+			for (unsigned int v = 0; v < numVertices; v++) {
+				if (mode == 0)
+					skinned[mode][v] = skinLinear(&palette[0], ids[v], weights[v], positions[v]);
+				else
+					skinned[mode][v] = skinDualQuat(&dualPalette[0], ids[v], weights[v], positions[v]);
+			}
+			nanos[mode] = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / numVertices;
+		}
+
+		//the two only agree where a vertex follows one bone, this is how far blending moves them apart here
+		float difference = 0.0f;
+		for (unsigned int v = 0; v < numVertices; v++)
+			difference = std::max(difference, glm::length(skinned[0][v] - skinned[1][v]));
+
+		std::cout << numBones << ", " << numBones * sizeof(glm::mat4) << " / " << numBones * sizeof(Affine) << " / " << numBones * sizeof(glm::dualquat) << ", "
+			<< convertMicros << ", " << nanos[0] << " / " << nanos[1] << ", " << difference << std::endl;
+	}
+}
@@ -0,0 +1,347 @@
+#include "ClipSet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+//returns the key i such that keys[i].time <= animationTime < keys[i + 1].time.
+//playback usually moves forward by less than a key per frame, so the cursor
+//from the last call is checked first and binary search is only used on seeks and loops
+template <typename Key>
+unsigned int findKey(float animationTime, const Key* keys, unsigned int numKeys, unsigned int &cursor) {
+	assert(numKeys > 1);
+
+	unsigned int i = cursor;
+	if (i < numKeys - 1 && animationTime >= keys[i].time) {
+		if (animationTime < keys[i + 1].time)
+			return i;
+		if (i + 2 < numKeys && animationTime < keys[i + 2].time) {
+			cursor = i + 1;
+			return cursor;
+		}
+	}
+
+	const Key* next = std::upper_bound(keys + 1, keys + numKeys, animationTime, [](float time, const Key& key) {
+		return time < key.time;
+	});
+
+	i = (unsigned int)(next - keys) - 1;
+	cursor = std::min(i, numKeys - 2);
+	return cursor;
+}
+
+template <typename Key>
+float keyFactor(float animationTime, const Key &start, const Key &end) {
+	float factor = (animationTime - start.time) / (end.time - start.time);
+	return glm::clamp(factor, 0.0f, 1.0f);
+}
+
+glm::vec3 interpolateVector(const std::vector<VectorKey> &keys, const glm::vec3 &bindValue, float animationTime, unsigned int &cursor) {
+	if (keys.empty())
+		return bindValue;
+	if (keys.size() == 1)
+		return keys[0].value;
+
+	unsigned int index = findKey(animationTime, &keys[0], (unsigned int)keys.size(), cursor);
+	const VectorKey& start = keys[index];
+	const VectorKey& end = keys[index + 1];
+	return glm::mix(start.value, end.value, keyFactor(animationTime, start, end));
+}
+
+glm::quat interpolateRotation(const std::vector<QuatKey> &keys, const glm::quat &bindValue, float animationTime, unsigned int &cursor) {
+	if (keys.empty())
+		return bindValue;
+	if (keys.size() == 1)
+		return keys[0].value;
+
+	unsigned int index = findKey(animationTime, &keys[0], (unsigned int)keys.size(), cursor);
+	const QuatKey& start = keys[index];
+	const QuatKey& end = keys[index + 1];
+	return glm::normalize(glm::slerp(start.value, end.value, keyFactor(animationTime, start, end)));
+}
+
+ClipSet::ClipSet(const aiScene* scene, const Skeleton &skeleton) {
+	for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
+		registerClip(scene->mAnimations[i], skeleton);
+	}
+}
+
+ClipSet::ClipSet(CacheReader &reader, const Skeleton &skeleton) {
+	clips.resize(reader.readCount());
+	for (unsigned int i = 0; i < clips.size() && !reader.failed(); i++) {
+		Clip &clip = clips[i];
+		clip.name = reader.readString();
+		clip.duration = reader.read<double>();
+		clip.ticksPerSecond = reader.read<float>();
+		clip.tracks.resize(reader.readCount());
+		for (unsigned int j = 0; j < clip.tracks.size() && !reader.failed(); j++) {
+			reader.readArray(clip.tracks[j].scalingKeys);
+			reader.readArray(clip.tracks[j].rotationKeys);
+			reader.readArray(clip.tracks[j].positionKeys);
+		}
+		reader.readArray(clip.jointTracks);
+
+		//evaluation indexes tracks through jointTracks for every joint of the skeleton
+		bool valid = clip.jointTracks.size() == skeleton.getNumJoints() && clip.ticksPerSecond > 0.0f;
+		for (unsigned int j = 0; j < clip.jointTracks.size() && valid; j++)
+			valid = clip.jointTracks[j] >= -1 && clip.jointTracks[j] < (int)clip.tracks.size();
+		if (!valid) {
+			reader.setFailed();
+			return;
+		}
+		setBindPose(clip, skeleton);
+
+		if (clipMap.find(clip.name) == clipMap.end())
+			clipMap[clip.name] = i;
+		maxTracks = std::max(maxTracks, (unsigned int)clip.tracks.size());
+	}
+}
+
+void ClipSet::write(CacheWriter &writer) const {
+	writer.write((unsigned long long)clips.size());
+	for (unsigned int i = 0; i < clips.size(); i++) {
+		const Clip &clip = clips[i];
+		writer.writeString(clip.name);
+		writer.write(clip.duration);
+		writer.write(clip.ticksPerSecond);
+		writer.write((unsigned long long)clip.tracks.size());
+		for (unsigned int j = 0; j < clip.tracks.size(); j++) {
+			writer.writeArray(clip.tracks[j].scalingKeys);
+			writer.writeArray(clip.tracks[j].rotationKeys);
+			writer.writeArray(clip.tracks[j].positionKeys);
+		}
+		writer.writeArray(clip.jointTracks);
+	}
+}
+
+void ClipSet::registerClip(const aiAnimation* animation, const Skeleton &skeleton) {
+	Clip clip;
+	clip.name = animation->mName.data;
+	clip.ticksPerSecond = (float)(animation->mTicksPerSecond != 0 ? animation->mTicksPerSecond : 25.0f);
+	clip.duration = animation->mDuration;
+	clip.jointTracks.resize(skeleton.getNumJoints(), -1);
+
+	std::map<std::string, unsigned int> channelMap;
+	for (unsigned int i = 0; i < animation->mNumChannels; i++)
+		channelMap.insert(std::make_pair(std::string(animation->mChannels[i]->mNodeName.data), i));
+
+	//tracks are kept in joint order so evaluating the hierarchy walks them front to back
+	for (unsigned int joint = 0; joint < skeleton.getNumJoints(); joint++) {
+		std::map<std::string, unsigned int>::iterator channel = channelMap.find(skeleton.getJointName(joint));
+		if (channel == channelMap.end())
+			continue;
+
+		const aiNodeAnim* nodeAnim = animation->mChannels[channel->second];
+
+		Track track;
+		for (unsigned int j = 0; j < nodeAnim->mNumScalingKeys; j++) {
+			const aiVectorKey& key = nodeAnim->mScalingKeys[j];
+			VectorKey scaling = { (float)key.mTime, glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z) };
+			track.scalingKeys.push_back(scaling);
+		}
+		for (unsigned int j = 0; j < nodeAnim->mNumRotationKeys; j++) {
+			const aiQuatKey& key = nodeAnim->mRotationKeys[j];
+			QuatKey rotation = { (float)key.mTime, glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z) };
+			track.rotationKeys.push_back(rotation);
+		}
+		for (unsigned int j = 0; j < nodeAnim->mNumPositionKeys; j++) {
+			const aiVectorKey& key = nodeAnim->mPositionKeys[j];
+			VectorKey position = { (float)key.mTime, glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z) };
+			track.positionKeys.push_back(position);
+		}
+
+		//the clip runs until its last key, whichever track that is on. a channel may leave a component without keys
+		if (nodeAnim->mNumScalingKeys > 0)
+			clip.duration = std::max(clip.duration, nodeAnim->mScalingKeys[nodeAnim->mNumScalingKeys - 1].mTime);
+		if (nodeAnim->mNumRotationKeys > 0)
+			clip.duration = std::max(clip.duration, nodeAnim->mRotationKeys[nodeAnim->mNumRotationKeys - 1].mTime);
+		if (nodeAnim->mNumPositionKeys > 0)
+			clip.duration = std::max(clip.duration, nodeAnim->mPositionKeys[nodeAnim->mNumPositionKeys - 1].mTime);
+
+		clip.jointTracks[joint] = (int)clip.tracks.size();
+		clip.tracks.push_back(track);
+	}
+	setBindPose(clip, skeleton);
+
+	unsigned int clipId = (unsigned int)clips.size();
+	if (clip.name.empty())
+		clip.name = std::to_string(clipId);
+	if (clipMap.find(clip.name) == clipMap.end())
+		clipMap[clip.name] = clipId;
+
+	maxTracks = std::max(maxTracks, (unsigned int)clip.tracks.size());
+	clips.push_back(clip);
+}
+
+void ClipSet::setBindPose(Clip &clip, const Skeleton &skeleton) {
+	for (unsigned int joint = 0; joint < clip.jointTracks.size() && joint < skeleton.getNumJoints(); joint++) {
+		int track = clip.jointTracks[joint];
+		if (track >= 0 && track < (int)clip.tracks.size()) {
+			Track &bound = clip.tracks[track];
+			affineToTRS(skeleton.getJoint(joint).bindLocal, bound.bindPosition, bound.bindRotation, bound.bindScale);
+		}
+	}
+}
+
+unsigned int ClipSet::getNumClips() const {
+	return (unsigned int)clips.size();
+}
+
+const Clip& ClipSet::getClip(unsigned int clipId) const {
+	return clips[clipId];
+}
+
+int ClipSet::findClip(const std::string &name) const {
+	std::map<std::string, unsigned int>::const_iterator clip = clipMap.find(name);
+	return clip != clipMap.end() ? (int)clip->second : -1;
+}
+
+unsigned int ClipSet::getMaxTracks() const {
+	return maxTracks;
+}
+
+void ClipSet::setPalettes(unsigned int clipId, const BakedPalette &palettes) {
+	clips[clipId].palettes = palettes;
+}
+
+BakeReport ClipSet::bake(float samplesPerSecond) {
+	BakeReport report;
+	if (samplesPerSecond <= 0.0f)
+		return report;
+
+	for (unsigned int i = 0; i < clips.size(); i++) {
+		clips[i].baked = bakeClip(clips[i], samplesPerSecond, report);
+		report.numFrames += clips[i].baked.numFrames;
+		report.bytes += clips[i].baked.samples.size() * sizeof(float);
+	}
+
+	return report;
+}
+
+BakedClip ClipSet::bakeClip(const Clip &clip, float samplesPerSecond, BakeReport &report) const {
+	BakedClip baked;
+	baked.framesPerTick = samplesPerSecond / clip.ticksPerSecond;
+	baked.numFrames = std::max((unsigned int)std::ceil(clip.duration * baked.framesPerTick), 1u) + 1;
+	baked.numTracks = (unsigned int)clip.tracks.size();
+	baked.stride = poseStride(baked.numTracks);
+
+	unsigned int frameSize = POSE_NUM_STREAMS * baked.stride;
+	baked.samples.resize(baked.numFrames * frameSize);
+
+	std::vector<KeyCursor> bakeCursors(baked.numTracks);
+	glm::vec3 scale, position, previousScale, previousPosition;
+	glm::quat rotation, previousRotation;
+	for (unsigned int frame = 0; frame < baked.numFrames; frame++) {
+		float animationTime = (float)frame / baked.framesPerTick;
+		float* pose = baked.samples.data() + frame * frameSize;
+
+		//padding lanes hold the identity so the samplers never normalise a zero quaternion
+		for (unsigned int track = 0; track < baked.stride; track++)
+			writePose(pose, baked.stride, track, glm::vec3(1.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.0f));
+
+		for (unsigned int track = 0; track < baked.numTracks; track++) {
+			sampleTrack(clip.tracks[track], animationTime, bakeCursors[track], scale, rotation, position);
+
+			if (frame > 0) {
+				readPose(pose - frameSize, baked.stride, track, previousScale, previousRotation, previousPosition);
+				if (glm::dot(previousRotation, rotation) < 0.0f)
+					rotation = -rotation;
+			}
+
+			writePose(pose, baked.stride, track, scale, rotation, position);
+		}
+	}
+
+	std::vector<float> scalarPose(frameSize), simdPose(frameSize);
+	for (unsigned int frame = 0; frame + 1 < baked.numFrames; frame++) {
+		const float* current = baked.samples.data() + frame * frameSize;
+		samplePoseScalar(current, current + frameSize, 0.5f, baked.stride, scalarPose.data());
+		samplePoseSimd(current, current + frameSize, 0.5f, baked.stride, simdPose.data());
+
+		for (unsigned int i = 0; i < frameSize; i++)
+			report.maxSamplerDifference = std::max(report.maxSamplerDifference, std::abs(scalarPose[i] - simdPose[i]));
+	}
+
+	//measure the error against the source keys and halfway between them, where linear resampling is worst
+	for (unsigned int track = 0; track < baked.numTracks; track++) {
+		const Track& source = clip.tracks[track];
+		KeyCursor sourceCursor;
+
+		std::vector<float> times;
+		for (unsigned int i = 0; i < source.scalingKeys.size(); i++)
+			times.push_back(source.scalingKeys[i].time);
+		for (unsigned int i = 0; i < source.rotationKeys.size(); i++)
+			times.push_back(source.rotationKeys[i].time);
+		for (unsigned int i = 0; i < source.positionKeys.size(); i++)
+			times.push_back(source.positionKeys[i].time);
+		std::sort(times.begin(), times.end());
+		times.erase(std::unique(times.begin(), times.end()), times.end());
+
+		unsigned int numTimes = (unsigned int)times.size();
+		for (unsigned int i = 1; i < numTimes; i++)
+			times.push_back((times[i - 1] + times[i]) * 0.5f);
+
+		for (unsigned int i = 0; i < times.size(); i++) {
+			float animationTime = times[i];
+			if (animationTime < 0.0f || animationTime >= clip.duration)
+				continue;
+
+			glm::vec3 sourceScale, sourcePosition, bakedScale, bakedPosition;
+			glm::quat sourceRotation, bakedRotation;
+			sampleTrack(source, animationTime, sourceCursor, sourceScale, sourceRotation, sourcePosition);
+			sampleBaked(baked, animationTime, track, bakedScale, bakedRotation, bakedPosition);
+
+			glm::quat difference = glm::conjugate(sourceRotation) * bakedRotation;
+			float angle = 2.0f * std::atan2(glm::length(glm::vec3(difference.x, difference.y, difference.z)), std::abs(difference.w));
+			report.maxScaleError = std::max(report.maxScaleError, glm::length(sourceScale - bakedScale));
+			report.maxRotationError = std::max(report.maxRotationError, glm::degrees(angle));
+			report.maxPositionError = std::max(report.maxPositionError, glm::length(sourcePosition - bakedPosition));
+		}
+	}
+
+	return baked;
+}
+
+void sampleTrack(const Track &track, float animationTime, KeyCursor &cursor, glm::vec3 &scale, glm::quat &rotation, glm::vec3 &position) {
+	scale = interpolateVector(track.scalingKeys, track.bindScale, animationTime, cursor.scaling);
+	rotation = interpolateRotation(track.rotationKeys, track.bindRotation, animationTime, cursor.rotation);
+	position = interpolateVector(track.positionKeys, track.bindPosition, animationTime, cursor.position);
+}
+
+void sampleBaked(const BakedClip &baked, float animationTime, int track, glm::vec3 &scale, glm::quat &rotation, glm::vec3 &position) {
+	float frameTime = animationTime * baked.framesPerTick;
+	unsigned int frame = (unsigned int)frameTime;
+	float factor = frameTime - (float)frame;
+
+	unsigned int frameSize = POSE_NUM_STREAMS * baked.stride;
+	const float* current = &baked.samples[frame * frameSize];
+
+	glm::vec3 nextScale, nextPosition;
+	glm::quat nextRotation;
+	readPose(current, baked.stride, track, scale, rotation, position);
+	readPose(current + frameSize, baked.stride, track, nextScale, nextRotation, nextPosition);
+
+	scale = glm::mix(scale, nextScale, factor);
+	//neighbouring rotations were put in the same hemisphere when baking, so nlerp needs no sign check
+	rotation = glm::normalize(rotation * (1.0f - factor) + nextRotation * factor);
+	position = glm::mix(position, nextPosition, factor);
+}
+
+void readPose(const float* pose, unsigned int stride, int track, glm::vec3 &scale, glm::quat &rotation, glm::vec3 &position) {
+	scale = glm::vec3(pose[POSE_SCALE_X * stride + track], pose[POSE_SCALE_Y * stride + track], pose[POSE_SCALE_Z * stride + track]);
+	rotation = glm::quat(pose[POSE_ROTATION_W * stride + track], pose[POSE_ROTATION_X * stride + track], pose[POSE_ROTATION_Y * stride + track], pose[POSE_ROTATION_Z * stride + track]);
+	position = glm::vec3(pose[POSE_POSITION_X * stride + track], pose[POSE_POSITION_Y * stride + track], pose[POSE_POSITION_Z * stride + track]);
+}
+
+void writePose(float* pose, unsigned int stride, int track, const glm::vec3 &scale, const glm::quat &rotation, const glm::vec3 &position) {
+	pose[POSE_SCALE_X * stride + track] = scale.x;
+	pose[POSE_SCALE_Y * stride + track] = scale.y;
+	pose[POSE_SCALE_Z * stride + track] = scale.z;
+	pose[POSE_ROTATION_X * stride + track] = rotation.x;
+	pose[POSE_ROTATION_Y * stride + track] = rotation.y;
+	pose[POSE_ROTATION_Z * stride + track] = rotation.z;
+	pose[POSE_ROTATION_W * stride + track] = rotation.w;
+	pose[POSE_POSITION_X * stride + track] = position.x;
+	pose[POSE_POSITION_Y * stride + track] = position.y;
+	pose[POSE_POSITION_Z * stride + track] = position.z;
+}
@@ -0,0 +1,215 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+
+GeometryArena::GeometryArena() {
+}
+
+GeometryArena::~GeometryArena() {
+	release();
+}
+
+GeometryArena::GeometryArena(GeometryArena &&other) {
+	*this = std::move(other);
+}
+
+GeometryArena& GeometryArena::operator=(GeometryArena &&other) {
+	if (this == &other)
+		return *this;
+
+	release();
+	vertices.swap(other.vertices);
+	indices.swap(other.indices);
+	bones.swap(other.bones);
+	numVertices = other.numVertices;
+	numIndices = other.numIndices;
+	boundsMin = other.boundsMin;
+	boundsMax = other.boundsMax;
+	uploadedBytes = other.uploadedBytes;
+
+	//the moved from arena ends up empty and owning nothing
+	VAO = other.VAO;
+	VBO = other.VBO;
+	boneVBO = other.boneVBO;
+	EBO = other.EBO;
+	other.VAO = other.VBO = other.boneVBO = other.EBO = 0;
+	other.numVertices = other.numIndices = 0;
+	return *this;
+}
+
+void GeometryArena::release() {
+	if (VAO == 0)
+		return;
+
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &boneVBO);
+	glDeleteBuffers(1, &EBO);
+	VAO = VBO = boneVBO = EBO = 0;
+	uploadedBytes = 0;
+}
+
+MeshRange GeometryArena::addMesh(unsigned int baseVertex, const std::vector<Vertex> &meshVertices, const std::vector<unsigned int> &meshIndices) {
+	MeshRange range;
+	range.firstIndex = (unsigned int)indices.size();
+	range.numIndices = (unsigned int)meshIndices.size();
+	range.baseVertex = baseVertex;
+	range.numVertices = (unsigned int)meshVertices.size();
+
+	if (vertices.size() < baseVertex + meshVertices.size())
+		vertices.resize(baseVertex + meshVertices.size());
+	std::copy(meshVertices.begin(), meshVertices.end(), vertices.begin() + baseVertex);
+	indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+
+	return range;
+}
+
+void GeometryArena::setBones(std::vector<VertexBoneData> &bones) {
+	this->bones.swap(bones);
+}
+
+void GeometryArena::setGeometry(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices) {
+	this->vertices.swap(vertices);
+	this->indices.swap(indices);
+}
+
+void GeometryArena::upload() {
+	release();
+	while (!isUploaded())
+		uploadSome(~(size_t)0);
+}
+
+size_t GeometryArena::uploadSome(size_t maxBytes) {
+	if (VAO == 0)
+		createBuffers();
+
+	//the three arrays are sent back to back as if they were one, so a call can end partway through any of them.
+	//the copy target leaves the array and element bindings of whatever VAO is bound alone
+	const unsigned char* sources[3] = { (const unsigned char*)vertices.data(), (const unsigned char*)bones.data(), (const unsigned char*)indices.data() };
+	size_t sizes[3] = { vertices.size() * sizeof(Vertex), bones.size() * sizeof(VertexBoneData), indices.size() * sizeof(unsigned int) };
+	unsigned int buffers[3] = { VBO, boneVBO, EBO };
+
+	size_t sent = 0;
+	size_t offset = 0;
+	for (unsigned int i = 0; i < 3 && sent < maxBytes; i++) {
+		if (uploadedBytes < offset + sizes[i]) {
+			size_t start = uploadedBytes - offset;
+			size_t count = std::min(sizes[i] - start, maxBytes - sent);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[i]);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, start, count, sources[i] + start);
+			uploadedBytes += count;
+			sent += count;
+		}
+		offset += sizes[i];
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	return sent;
+}
+
+bool GeometryArena::isUploaded() const {
+	return VAO != 0 && uploadedBytes == getGpuBytes();
+}
+
+void GeometryArena::createBuffers() {
+	//meshes without bones still need weights to read, all zero leaves them in the bind pose
+	bones.resize(vertices.size());
+
+	numVertices = (unsigned int)vertices.size();
+	numIndices = (unsigned int)indices.size();
+	boundsMin = boundsMax = vertices.empty() ? glm::vec3(0.0f) : vertices[0].position;
+	for (unsigned int i = 0; i < numVertices; i++) {
+		boundsMin = glm::min(boundsMin, vertices[i].position);
+		boundsMax = glm::max(boundsMax, vertices[i].position);
+	}
+
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+
+	glGenBuffers(1, &VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), NULL, GL_STATIC_DRAW);
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	glEnableVertexAttribArray(0);
+
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+	glEnableVertexAttribArray(1);
+
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+	glEnableVertexAttribArray(2);
+
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
+	glEnableVertexAttribArray(3);
+
+	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
+	glEnableVertexAttribArray(4);
+
+	glGenBuffers(1, &boneVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, boneVBO);
+	glBufferData(GL_ARRAY_BUFFER, bones.size() * sizeof(VertexBoneData), NULL, GL_STATIC_DRAW);
+
+	glVertexAttribIPointer(5, 4, GL_INT, sizeof(VertexBoneData), (void*)0);
+	glEnableVertexAttribArray(5);
+
+	glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData), (void*)offsetof(VertexBoneData, weights));
+	glEnableVertexAttribArray(6);
+
+	glGenBuffers(1, &EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::releaseCpuCopies() {
+	//swapping with empty vectors gives the memory back, clear() would keep the capacity
+	std::vector<Vertex>().swap(vertices);
+	std::vector<unsigned int>().swap(indices);
+	std::vector<VertexBoneData>().swap(bones);
+}
+
+void GeometryArena::bind() const {
+	glBindVertexArray(VAO);
+}
+
+void GeometryArena::unbind() const {
+	glBindVertexArray(0);
+}
+
+const std::vector<Vertex>& GeometryArena::getVertices() const {
+	return vertices;
+}
+
+const std::vector<unsigned int>& GeometryArena::getIndices() const {
+	return indices;
+}
+
+const std::vector<VertexBoneData>& GeometryArena::getBones() const {
+	return bones;
+}
+
+unsigned int GeometryArena::getNumVertices() const {
+	return numVertices;
+}
+
+unsigned int GeometryArena::getNumIndices() const {
+	return numIndices;
+}
+
+const glm::vec3& GeometryArena::getBoundsMin() const {
+	return boundsMin;
+}
+
+const glm::vec3& GeometryArena::getBoundsMax() const {
+	return boundsMax;
+}
+
+size_t GeometryArena::getGpuBytes() const {
+	return numVertices * (sizeof(Vertex) + sizeof(VertexBoneData)) + numIndices * sizeof(unsigned int);
+}
+
+size_t GeometryArena::getCpuBytes() const {
+	return vertices.capacity() * sizeof(Vertex) + bones.capacity() * sizeof(VertexBoneData) + indices.capacity() * sizeof(unsigned int);
+}
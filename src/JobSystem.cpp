@@ -0,0 +1,112 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned int numThreads) : slices(std::max(numThreads != 0 ? numThreads : std::thread::hardware_concurrency(), 1u)) {
+	steals = 0;
+	for (unsigned int i = 0; i < slices.size(); i++) {
+		slices[i].next = 0;
+		slices[i].end = 0;
+	}
+
+	//thread 0 is whoever calls parallelFor
+	for (unsigned int i = 1; i < slices.size(); i++) {
+		workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+void JobSystem::parallelFor(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)> &job) {
+	if (count == 0)
+		return;
+
+	grain = std::max(grain, 1u);
+	if (workers.empty() || count <= grain) {
+		for (unsigned int begin = 0; begin < count; begin += grain)
+			job(begin, std::min(begin + grain, count));
+		return;
+	}
+
+	//hand out whole chunks so no chunk straddles two slices
+	unsigned int numThreads = (unsigned int)slices.size();
+	unsigned int numChunks = (count + grain - 1) / grain;
+	for (unsigned int i = 0; i < numThreads; i++) {
+		slices[i].next = std::min(numChunks * i / numThreads * grain, count);
+		slices[i].end = std::min(numChunks * (i + 1) / numThreads * grain, count);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->job = &job;
+		this->grain = grain;
+		busyWorkers = (unsigned int)workers.size();
+		batch++;
+	}
+	wake.notify_all();
+
+	runSlices(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this]() { return busyWorkers == 0; });
+	this->job = NULL;
+}
+
+void JobSystem::workerLoop(unsigned int thread) {
+	unsigned long long seenBatch = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this, seenBatch]() { return quit || batch != seenBatch; });
+			if (quit)
+				return;
+			seenBatch = batch;
+		}
+
+		runSlices(thread);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busyWorkers == 0)
+			done.notify_one();
+	}
+}
+
+void JobSystem::runSlices(unsigned int thread) {
+	unsigned int numThreads = (unsigned int)slices.size();
+	unsigned long long stolen = 0;
+
+	//own slice first, then walk the others. claiming past a slice's end just means it ran dry
+	for (unsigned int i = 0; i < numThreads; i++) {
+		Slice& slice = slices[(thread + i) % numThreads];
+		while (true) {
+			unsigned int begin = slice.next.fetch_add(grain, std::memory_order_relaxed);
+			if (begin >= slice.end)
+				break;
+
+			(*job)(begin, std::min(begin + grain, slice.end));
+			if (i > 0)
+				stolen++;
+		}
+	}
+
+	if (stolen > 0)
+		steals += stolen;
+}
+
+unsigned int JobSystem::getNumThreads() const {
+	return (unsigned int)slices.size();
+}
+
+unsigned long long JobSystem::getSteals() const {
+	return steals;
+}
@@ -1,61 +1,21 @@
 #include "Mesh.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, std::vector<VertexBoneData> bones) {
-	this->vertices = vertices;
-	this->indices = indices;
-	this->textures = textures;
-	this->bones = bones;
-
-	loadMesh();
+Mesh::Mesh(const MeshRange &range, std::vector<Texture> textures) : range(range), textures(std::move(textures)) {
 }
 
-void Mesh::loadMesh() {
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glGenBuffers(1, &boneVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, boneVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(bones[0]) * bones.size(), &bones[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
-
-	glGenBuffers(1, &EBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	glEnableVertexAttribArray(1);
-
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
-	glEnableVertexAttribArray(2);
-
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
-	glEnableVertexAttribArray(3);
-
-	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
-	glEnableVertexAttribArray(4);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+void Mesh::draw(Shader& shader) {
+	bindTextures(shader);
 
-	glBindBuffer(GL_ARRAY_BUFFER, boneVBO);
-	glVertexAttribIPointer(5, 4, GL_INT, sizeof(VertexBoneData), (void*)0);
-	glEnableVertexAttribArray(5);
+	glDrawElementsBaseVertex(GL_TRIANGLES, range.numIndices, GL_UNSIGNED_INT, (void*)(range.firstIndex * sizeof(unsigned int)), range.baseVertex);
+}
 
-	glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData), (void*)offsetof(VertexBoneData, weights));
-	glEnableVertexAttribArray(6);
+void Mesh::drawInstanced(Shader& shader, unsigned int numInstances) {
+	bindTextures(shader);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.numIndices, GL_UNSIGNED_INT, (void*)(range.firstIndex * sizeof(unsigned int)), numInstances, range.baseVertex);
 }
 
-void Mesh::draw(Shader& shader) {
+void Mesh::bindTextures(Shader& shader) {
 	unsigned int diffuseNr = 1;
 	unsigned int normalNr = 1;
 	unsigned int aoNr = 1;
@@ -74,8 +34,12 @@ void Mesh::draw(Shader& shader) {
 		glBindTexture(GL_TEXTURE_2D, textures[i].id);
 		glActiveTexture(GL_TEXTURE0);
 	}
+}
+
+const MeshRange& Mesh::getRange() const {
+	return range;
+}
 
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+const std::vector<Texture>& Mesh::getTextures() const {
+	return textures;
 }
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+//cache Forsyth's scores assume, and the weights of his reference implementation
+const int FORSYTH_CACHE_SIZE = 32;
+const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+const float FORSYTH_CACHE_DECAY = 1.5f;
+const float FORSYTH_VALENCE_SCALE = 2.0f;
+const float FORSYTH_VALENCE_POWER = 0.5f;
+
+VertexCacheStats simulateVertexCache(const unsigned int* indices, size_t numIndices, unsigned int numVertices, unsigned int cacheSize) {
+	VertexCacheStats stats;
+	stats.triangles = (unsigned int)(numIndices / 3);
+
+	//a FIFO cache only evicts on misses, so each vertex just remembers when it went in
+	std::vector<unsigned int> insertedAt(numVertices, 0);
+	unsigned int time = 0;
+	for (size_t i = 0; i < numIndices; i++) {
+		unsigned int vertex = indices[i];
+		if (insertedAt[vertex] == 0)
+			stats.vertices++;
+
+		if (insertedAt[vertex] == 0 || time - insertedAt[vertex] >= cacheSize) {
+			stats.transforms++;
+			insertedAt[vertex] = ++time;
+		}
+	}
+
+	if (stats.triangles > 0)
+		stats.acmr = (float)stats.transforms / stats.triangles;
+	if (stats.vertices > 0)
+		stats.atvr = (float)stats.transforms / stats.vertices;
+	return stats;
+}
+
+void addVertexCacheStats(VertexCacheStats &a, const VertexCacheStats &b) {
+	a.triangles += b.triangles;
+	a.vertices += b.vertices;
+	a.transforms += b.transforms;
+	a.acmr = a.triangles > 0 ? (float)a.transforms / a.triangles : 0.0f;
+	a.atvr = a.vertices > 0 ? (float)a.transforms / a.vertices : 0.0f;
+}
+
+float forsythScore(int cachePosition, unsigned int remainingTriangles) {
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		//the three vertices of the triangle just drawn score the same, whatever order they went in
+		if (cachePosition < 3)
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		else
+			score = std::pow(1.0f - (float)(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY);
+	}
+
+	//vertices with few triangles left are finished off first, so they don't linger and cost a second miss later
+	return score + FORSYTH_VALENCE_SCALE * std::pow((float)remainingTriangles, -FORSYTH_VALENCE_POWER);
+}
+
+//the different vertices of a triangle, fewer than three for a degenerate one. the adjacency holds a triangle once
+//per vertex, so one that repeats a vertex is still removed from it exactly once
+static unsigned int distinctCorners(const unsigned int* triangle, unsigned int* corners) {
+	unsigned int count = 0;
+	for (unsigned int k = 0; k < 3; k++) {
+		if (std::find(corners, corners + count, triangle[k]) == corners + count)
+			corners[count++] = triangle[k];
+	}
+	return count;
+}
+
+void optimizeVertexCache(unsigned int* indices, size_t numIndices, unsigned int numVertices) {
+	unsigned int numTriangles = (unsigned int)(numIndices / 3);
+	if (numTriangles < 2)
+		return;
+
+	//triangles of every vertex, the live ones first, so removing a drawn one is a swap with the last live one
+	std::vector<unsigned int> remaining(numVertices, 0);
+	unsigned int corners[3];
+	for (unsigned int t = 0; t < numTriangles; t++) {
+		unsigned int numCorners = distinctCorners(&indices[t * 3], corners);
+		for (unsigned int k = 0; k < numCorners; k++) {
+			remaining[corners[k]]++;
+		}
+	}
+	std::vector<unsigned int> firstTriangle(numVertices + 1, 0);
+	for (unsigned int i = 0; i < numVertices; i++) {
+		firstTriangle[i + 1] = firstTriangle[i] + remaining[i];
+	}
+	std::vector<unsigned int> adjacency(firstTriangle[numVertices]);
+	std::vector<unsigned int> filled(numVertices, 0);
+	for (unsigned int t = 0; t < numTriangles; t++) {
+		unsigned int numCorners = distinctCorners(&indices[t * 3], corners);
+		for (unsigned int k = 0; k < numCorners; k++) {
+			unsigned int vertex = corners[k];
+			adjacency[firstTriangle[vertex] + filled[vertex]++] = t;
+		}
+	}
+
+	std::vector<int> cachePosition(numVertices, -1);
+	std::vector<float> vertexScore(numVertices);
+	for (unsigned int i = 0; i < numVertices; i++) {
+		vertexScore[i] = forsythScore(-1, remaining[i]);
+	}
+
+	std::vector<float> triangleScore(numTriangles);
+	std::vector<bool> drawn(numTriangles, false);
+	int best = 0;
+	for (unsigned int t = 0; t < numTriangles; t++) {
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		if (triangleScore[t] > triangleScore[best])
+			best = (int)t;
+	}
+
+	std::vector<unsigned int> output(numTriangles * 3);
+	std::vector<unsigned int> cache, nextCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+	unsigned int scan = 0; //dead ends continue from the first triangle not drawn yet, in input order
+
+	for (unsigned int drawnCount = 0; drawnCount < numTriangles; drawnCount++) {
+		if (best < 0) {
+			while (drawn[scan])
+				scan++;
+			best = (int)scan;
+		}
+
+		unsigned int* triangle = &indices[best * 3];
+		std::copy(triangle, triangle + 3, &output[drawnCount * 3]);
+		drawn[best] = true;
+
+		unsigned int numCorners = distinctCorners(triangle, corners);
+		for (unsigned int k = 0; k < numCorners; k++) {
+			unsigned int vertex = corners[k];
+			unsigned int* live = &adjacency[firstTriangle[vertex]];
+			for (unsigned int j = 0; j < remaining[vertex]; j++) {
+				if (live[j] == (unsigned int)best) {
+					std::swap(live[j], live[remaining[vertex] - 1]);
+					break;
+				}
+			}
+			remaining[vertex]--;
+		}
+
+		//the drawn triangle goes to the front, everything else shifts back and the tail falls out
+		nextCache.assign(corners, corners + numCorners);
+		for (unsigned int i = 0; i < cache.size(); i++) {
+			unsigned int vertex = cache[i];
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				nextCache.push_back(vertex);
+		}
+		for (unsigned int i = 0; i < nextCache.size(); i++) {
+			int position = i < (unsigned int)FORSYTH_CACHE_SIZE ? (int)i : -1;
+			unsigned int vertex = nextCache[i];
+			cachePosition[vertex] = position;
+
+			float score = forsythScore(position, remaining[vertex]);
+			float change = score - vertexScore[vertex];
+			vertexScore[vertex] = score;
+			for (unsigned int j = 0; j < remaining[vertex]; j++) {
+				unsigned int t = adjacency[firstTriangle[vertex] + j];
+				//a triangle scores every corner, a degenerate one its repeated vertex twice as before
+				triangleScore[t] += change * (float)std::count(&indices[t * 3], &indices[t * 3 + 3], vertex);
+			}
+		}
+		if (nextCache.size() > (unsigned int)FORSYTH_CACHE_SIZE)
+			nextCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(nextCache);
+
+		//only triangles touching the cache changed score, the next one is picked among them
+		best = -1;
+		float bestScore = -1.0f;
+		for (unsigned int i = 0; i < cache.size(); i++) {
+			unsigned int vertex = cache[i];
+			for (unsigned int j = 0; j < remaining[vertex]; j++) {
+				unsigned int t = adjacency[firstTriangle[vertex] + j];
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					best = (int)t;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeOverdraw(unsigned int* indices, size_t numIndices, const Vertex* vertices, unsigned int numVertices) {
+	unsigned int numTriangles = (unsigned int)(numIndices / 3);
+	if (numTriangles < 2)
+		return;
+
+	//a run starts wherever a triangle misses on all three vertices, the cache holds nothing of the run before it,
+	//so moving runs around keeps the misses where they were
+	std::vector<unsigned int> runStarts;
+	std::vector<unsigned int> insertedAt(numVertices, 0);
+	unsigned int time = 0;
+	for (unsigned int t = 0; t < numTriangles; t++) {
+		unsigned int misses = 0;
+		for (unsigned int k = 0; k < 3; k++) {
+			unsigned int vertex = indices[t * 3 + k];
+			if (insertedAt[vertex] == 0 || time - insertedAt[vertex] >= VERTEX_CACHE_SIZE) {
+				misses++;
+				insertedAt[vertex] = ++time;
+			}
+		}
+		if (misses == 3 || t == 0)
+			runStarts.push_back(t);
+	}
+	if (runStarts.size() < 2)
+		return;
+	runStarts.push_back(numTriangles);
+
+	//area weighted centre and normal of the mesh and of each run
+	unsigned int numRuns = (unsigned int)runStarts.size() - 1;
+	std::vector<glm::vec3> runCentres(numRuns), runNormals(numRuns);
+	glm::vec3 meshCentre(0.0f);
+	float meshArea = 0.0f;
+	for (unsigned int r = 0; r < numRuns; r++) {
+		glm::vec3 centre(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (unsigned int t = runStarts[r]; t < runStarts[r + 1]; t++) {
+			const glm::vec3 &a = vertices[indices[t * 3]].position;
+			const glm::vec3 &b = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3 &c = vertices[indices[t * 3 + 2]].position;
+			glm::vec3 cross = glm::cross(b - a, c - a);
+			float triangleArea = glm::length(cross);
+			centre += (a + b + c) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+
+		meshCentre += centre;
+		meshArea += area;
+		runCentres[r] = area > 0.0f ? centre / area : vertices[indices[runStarts[r] * 3]].position;
+		runNormals[r] = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+	}
+	if (meshArea > 0.0f)
+		meshCentre /= meshArea;
+
+	//runs facing away from the middle are on the outside and tend to hide the rest, they go first
+	std::vector<float> keys(numRuns);
+	std::vector<unsigned int> order(numRuns);
+	for (unsigned int r = 0; r < numRuns; r++) {
+		keys[r] = glm::dot(runCentres[r] - meshCentre, runNormals[r]);
+		order[r] = r;
+	}
+	std::stable_sort(order.begin(), order.end(), [&keys](unsigned int a, unsigned int b) {
+		return keys[a] > keys[b];
+	});
+
+	std::vector<unsigned int> output;
+	output.reserve(numTriangles * 3);
+	for (unsigned int i = 0; i < numRuns; i++) {
+		unsigned int r = order[i];
+		output.insert(output.end(), indices + runStarts[r] * 3, indices + runStarts[r + 1] * 3);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+std::vector<unsigned int> optimizeVertexFetch(unsigned int* indices, size_t numIndices, unsigned int numVertices) {
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(numVertices, unused);
+	unsigned int next = 0;
+	for (size_t i = 0; i < numIndices; i++) {
+		unsigned int &vertex = indices[i];
+		if (remap[vertex] == unused)
+			remap[vertex] = next++;
+		vertex = remap[vertex];
+	}
+
+	for (unsigned int i = 0; i < numVertices; i++) {
+		if (remap[i] == unused)
+			remap[i] = next++;
+	}
+
+	return remap;
+}
@@ -1,61 +1,605 @@
 #include "Model.h"
 
-unsigned int textureFromFile(const char* path, const std::string& dir);
+#include <algorithm>
+#include <chrono>
+
+//decoding only touches memory so it can run on any thread, the upload has to happen on the gl one
+TextureImage decodeTexture(const std::string &path, const std::string &dir);
+unsigned int uploadTexture(TextureImage &image, const std::string &path);
 glm::vec3 getVec(aiVector3D el);
 glm::mat4 castMat4(const aiMatrix4x4 &mat);
 glm::quat castQuat(aiQuaternion &q);
 
-Model::Model(const char* path) {
-	loadModel(path);
+//high enough to stay clear of the material textures bound by Mesh::draw
+const unsigned int PALETTE_TEXTURE_UNIT = 15;
+
+unsigned int importFlags(ImportProfile profile) {
+	//normals and tangents are read by the shaders, so every profile needs them
+	switch (profile) {
+		case IMPORT_FAST_LOAD:
+			return aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_CalcTangentSpace;
+		case IMPORT_RUNTIME_OPTIMAL:
+			return aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices
+				| aiProcess_LimitBoneWeights | aiProcess_ImproveCacheLocality | aiProcess_OptimizeMeshes | aiProcess_SortByPType;
+		case IMPORT_EDITOR:
+			return aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices
+				| aiProcess_LimitBoneWeights | aiProcess_ValidateDataStructure;
+	}
+
+	return 0;
+}
+
+const char* importProfileName(ImportProfile profile) {
+	switch (profile) {
+		case IMPORT_FAST_LOAD:
+			return "fast-load";
+		case IMPORT_RUNTIME_OPTIMAL:
+			return "runtime-optimal";
+		case IMPORT_EDITOR:
+			return "editor";
+	}
+
+	return "unknown";
+}
+
+bool parseImportProfile(const std::string &name, ImportProfile &profile) {
+	const ImportProfile profiles[] = { IMPORT_FAST_LOAD, IMPORT_RUNTIME_OPTIMAL, IMPORT_EDITOR };
+	for (unsigned int i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+		if (name == importProfileName(profiles[i])) {
+			profile = profiles[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+Model::Model(const char* path, const ModelSettings &settings, bool upload) {
+	this->settings = settings;
+	failed = !loadModel(path);
+
+	while (upload && !failed && !resident)
+		uploadSome(~(size_t)0);
+}
+
+Model::~Model() {
+	//a model dropped halfway through its load still holds decoded images and may have no gl objects at all
+	for (unsigned int i = 0; i < loaded_textures.size(); i++) {
+		if (loaded_textures[i].id != 0)
+			glDeleteTextures(1, &loaded_textures[i].id);
+	}
+	for (unsigned int i = 0; i < textureImages.size(); i++) {
+		stbi_image_free(textureImages[i].data);
+	}
+	if (paletteBlock != 0)
+		glDeleteBuffers(1, &paletteBlock);
+
+	delete paletteRing;
+	delete animator;
 }
 
 void Model::draw(Shader &shader) {
+	//linear blend skinning or a skeleton that didn't fit the Palette block, see createPaletteBlock
+	if (animator && animator->getNumBones() > 0 && paletteBlock == 0)
+		return;
+
+	geometry.bind();
 	for (unsigned int i = 0; i < meshes.size(); i++) {
 		meshes[i].draw(shader);
 	}
+	geometry.unbind();
+
+	drawStats.drawCalls += (unsigned int)meshes.size();
+	drawStats.instances++;
+}
+
+void Model::drawInstanced(Shader &shader, const AnimationInstance* instances, const glm::mat4* transforms, unsigned int numInstances) {
+	assert(settings.skinning == SKINNING_LINEAR);
+	if (numInstances == 0)
+		return;
+
+	unsigned int numBones = animator->getNumBones();
+	unsigned int batch = getInstanceBatch();
+	for (unsigned int first = 0; first < numInstances; first += batch) {
+		unsigned int count = std::min(batch, numInstances - first);
+		Affine* data = mapInstanceData(count);
+		for (unsigned int i = first; i < first + count; i++, data += numBones + 1) {
+			data[0] = affineFromMat4(transforms[i]);
+			std::copy(instances[i].palette.begin(), instances[i].palette.begin() + std::min((unsigned int)instances[i].palette.size(), numBones), data + 1);
+		}
+
+		drawInstanceData(shader, count);
+	}
+}
+
+void Model::drawInstanced(Shader &shader, const Affine* palettes, const glm::mat4* transforms, unsigned int numInstances) {
+	assert(settings.skinning == SKINNING_LINEAR);
+	if (numInstances == 0)
+		return;
+
+	unsigned int numBones = animator->getNumBones();
+	unsigned int batch = getInstanceBatch();
+	for (unsigned int first = 0; first < numInstances; first += batch) {
+		unsigned int count = std::min(batch, numInstances - first);
+		Affine* data = mapInstanceData(count);
+		for (unsigned int i = first; i < first + count; i++, data += numBones + 1) {
+			data[0] = affineFromMat4(transforms[i]);
+			std::copy(palettes + (size_t)i * numBones, palettes + (size_t)(i + 1) * numBones, data + 1);
+		}
+
+		drawInstanceData(shader, count);
+	}
+}
+
+unsigned int Model::getInstanceBatch() {
+	if (!paletteRing)
+		paletteRing = new PaletteRing();
+
+	//past the texture buffer limit the crowd is drawn in several batches, each in its own region of the ring.
+	//more than PALETTE_RING_REGIONS batches in a frame wait on the gpu for the earlier ones
+	size_t batch = paletteRing->getMaxCount() / (animator->getNumBones() + 1);
+	assert(batch > 0);
+	return (unsigned int)batch;
+}
+
+Affine* Model::mapInstanceData(unsigned int numInstances) {
+	return paletteRing->map((size_t)numInstances * (animator->getNumBones() + 1));
+}
+
+void Model::drawInstanceData(Shader &shader, unsigned int numInstances) {
+	unsigned int stride = animator->getNumBones() + 1;
+	int base = paletteRing->unmap();
+
+	glActiveTexture(GL_TEXTURE0 + PALETTE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, paletteRing->getTexture());
+	glActiveTexture(GL_TEXTURE0);
+	shader.setInt("palettes", PALETTE_TEXTURE_UNIT);
+	shader.setInt("paletteBase", base);
+	shader.setInt("paletteStride", (int)stride * 3);
+
+	geometry.bind();
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		meshes[i].drawInstanced(shader, numInstances);
+	}
+	geometry.unbind();
+	paletteRing->fence();
+
+	drawStats.drawCalls += (unsigned int)meshes.size();
+	drawStats.instances += numInstances;
+	drawStats.uploadBytes += (size_t)numInstances * stride * sizeof(Affine);
 }
 
-void Model::loadModel(const std::string& path) {
+const DrawStats& Model::getDrawStats() const {
+	return drawStats;
+}
+
+const LoadTimes& Model::getLoadTimes() const {
+	return loadTimes;
+}
+
+const GeometryArena& Model::getGeometry() const {
+	return geometry;
+}
+
+void Model::resetDrawStats() {
+	drawStats = DrawStats();
+}
+
+bool Model::loadModel(const std::string& path) {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	dir = path.substr(0, path.find_last_of('/'));
+
+	std::unique_ptr<JobSystem> loadJobs;
+	if (!settings.jobs)
+		loadJobs.reset(new JobSystem());
+	JobSystem &jobs = settings.jobs ? *settings.jobs : *loadJobs;
+
+	//one cooked file per profile, so switching between them doesn't throw the other one away
+	std::string cookedPath = path + "." + importProfileName(settings.profile) + ".cooked";
+	unsigned long long sourceHash = 0;
+	double coldMillis = 0.0;
+	bool cooked = false;
+	if (settings.useCache) {
+		sourceHash = hashModelSource(path);
+		cooked = readCooked(cookedPath, sourceHash, coldMillis, jobs);
+	}
+
+	if (!cooked && !importModel(path, jobs))
+		return false;
+
+	double loadMillis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	if (cooked) {
+		std::cout << "Loaded " << path << " from the cooked cache in " << loadMillis << " ms (" << coldMillis
+			<< " ms through assimp when it was cooked)" << std::endl;
+	}
+	else {
+		std::cout << "Imported " << path << " through assimp in " << loadMillis << " ms" << std::endl;
+		if (settings.useCache)
+			writeCooked(cookedPath, sourceHash, loadMillis);
+	}
+
+	//every mesh starts with an empty cache, as it would after the state change between draws
+	VertexCacheStats cacheStats;
+	for (unsigned int i = 0; i < pendingMeshes.size(); i++) {
+		const MeshRange &range = pendingMeshes[i].range;
+		if (range.numIndices == 0)
+			continue;
+
+		VertexCacheStats meshStats = simulateVertexCache(&geometry.getIndices()[range.firstIndex], range.numIndices, range.numVertices);
+		cacheStats.triangles += meshStats.triangles;
+		cacheStats.transforms += meshStats.transforms;
+	}
+	cacheStats.acmr = cacheStats.triangles > 0 ? (float)cacheStats.transforms / cacheStats.triangles : 0.0f;
+	std::cout << "Import profile " << importProfileName(settings.profile) << ": " << geometry.getVertices().size() << " vertices, "
+		<< geometry.getIndices().size() << " indices, ACMR " << cacheStats.acmr << " (" << VERTEX_CACHE_SIZE << " entry FIFO), ";
+	if (cooked)
+		std::cout << "no import, read from the cooked cache" << std::endl;
+	else
+		std::cout << "assimp import " << loadTimes.importMillis << " ms" << std::endl;
+
+	std::cout << "Mesh processing on " << jobs.getNumThreads() << " threads: " << loadTimes.workMillis << " ms of cpu work done in "
+		<< loadTimes.cpuMillis << " ms (" << loadTimes.workMillis / std::max(loadTimes.cpuMillis, 0.001) << "x)" << std::endl;
+
+	setupAnimation();
+	return true;
+}
+
+size_t Model::uploadSome(size_t maxBytes) {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	size_t sent = 0;
+	while (!failed && !resident && (sent == 0 || sent < maxBytes)) {
+		if (!geometry.isUploaded()) {
+			//never ask for nothing, an arena that has been created is always left a byte further on
+			sent += geometry.uploadSome(std::max(maxBytes - sent, (size_t)1));
+		}
+		else if (nextTexture < loaded_textures.size()) {
+			//a texture goes up whole, it waits for the next call if it would overrun what is left
+			TextureImage &image = textureImages[nextTexture];
+			size_t bytes = image.data ? (size_t)image.width * image.height * image.channels : 0;
+			if (sent > 0 && bytes > maxBytes - sent)
+				break;
+
+			loaded_textures[nextTexture].id = uploadTexture(image, loaded_textures[nextTexture].path);
+			sent += bytes;
+			nextTexture++;
+		}
+		else
+			finishUpload();
+	}
+
+	loadTimes.glMillis += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return sent;
+}
+
+void Model::finishUpload() {
+	std::vector<TextureImage>().swap(textureImages);
+	for (unsigned int i = 0; i < pendingMeshes.size(); i++) {
+		std::vector<Texture> meshTextures;
+		for (unsigned int j = 0; j < pendingMeshes[i].textures.size(); j++) {
+			meshTextures.push_back(loaded_textures[pendingMeshes[i].textures[j]]);
+		}
+		meshes.push_back(Mesh(pendingMeshes[i].range, std::move(meshTextures)));
+	}
+	std::vector<PendingMesh>().swap(pendingMeshes);
+
+	createPaletteBlock();
+	resident = true;
+
+	size_t cpuBytes = geometry.getCpuBytes();
+	if (settings.releaseCpuGeometry)
+		geometry.releaseCpuCopies();
+
+	//before the arena every mesh had its own buffers and CPU copies, including all of the model's bone weights
+	size_t separateBytes = 0;
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		const MeshRange &range = meshes[i].getRange();
+		separateBytes += range.numVertices * sizeof(Vertex) + range.numIndices * sizeof(unsigned int) + totalVertices * sizeof(VertexBoneData);
+	}
+	std::cout << "Geometry: " << meshes.size() << " meshes in one arena of " << geometry.getNumVertices() << " vertices and "
+		<< geometry.getNumIndices() << " indices, " << geometry.getGpuBytes() / 1024 << " KB on the gpu, " << geometry.getCpuBytes() / 1024
+		<< " KB kept on the cpu of " << cpuBytes / 1024 << " KB (buffers per mesh: " << separateBytes / 1024 << " KB on the gpu, "
+		<< (separateBytes + totalVertices * sizeof(VertexBoneData)) / 1024 << " KB on the cpu), gl objects in "
+		<< loadTimes.glMillis << " ms" << std::endl;
+}
+
+bool Model::isResident() const {
+	return resident;
+}
+
+bool Model::hasFailed() const {
+	return failed;
+}
+
+bool Model::importModel(const std::string &path, JobSystem &jobs) {
+	//the importer keeps the scene and frees it on return, everything needed has been copied out by then
 	Assimp::Importer importer;
+	//lines and points left by SortByPType can't be drawn as triangles, so they are dropped
+	importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+	importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, MAX_NUM_BONES);
 
-	scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_CalcTangentSpace);
-	scene = importer.GetOrphanedScene();
+	std::chrono::high_resolution_clock::time_point importStart = std::chrono::high_resolution_clock::now();
+	const aiScene* scene = importer.ReadFile(path, importFlags(settings.profile));
+	loadTimes.importMillis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - importStart).count();
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
 		std::cout << "Could not load model: " << importer.GetErrorString() << std::endl;
-		return;
+		return false;
 	}
 
 	animator = new Animator(scene);
 
-	dir = path.substr(0, path.find_last_of('/'));
-
 	for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
 		baseVertex.push_back(totalVertices);
 		totalVertices += scene->mMeshes[i]->mNumVertices;
 	}
 
-	bones.resize(totalVertices);
+	std::vector<VertexBoneData> bones(totalVertices);
+
+	std::vector<unsigned int> meshOrder;
+	collectMeshes(scene->mRootNode, meshOrder);
+
+	//several nodes may reference one scene mesh. its vertices and weights live once in the arena, so it is
+	//converted, weighted and reordered once and every reference draws the same range
+	std::vector<unsigned int> sceneMeshes;
+	std::vector<int> slotOfSceneMesh(scene->mNumMeshes, -1);
+	std::vector<unsigned int> meshSlot(meshOrder.size());
+	for (unsigned int i = 0; i < meshOrder.size(); i++) {
+		if (slotOfSceneMesh[meshOrder[i]] < 0) {
+			slotOfSceneMesh[meshOrder[i]] = (int)sceneMeshes.size();
+			sceneMeshes.push_back(meshOrder[i]);
+		}
+		meshSlot[i] = (unsigned int)slotOfSceneMesh[meshOrder[i]];
+	}
+	unsigned int numMeshes = (unsigned int)sceneMeshes.size();
+
+	//registering bones grows the skeleton's bone table, so it stays on this thread
+	for (unsigned int i = 0; i < numMeshes; i++) {
+		animator->loadBones(sceneMeshes[i], scene->mMeshes[sceneMeshes[i]], bones, baseVertex);
+	}
+
+	//texture references of every mesh, gathered up front so files shared between meshes are decoded once
+	std::vector<std::string> texturePaths, textureTypes;
+	std::vector<unsigned int> firstTexture(numMeshes + 1);
+	for (unsigned int i = 0; i < numMeshes; i++) {
+		firstTexture[i] = (unsigned int)texturePaths.size();
+		aiMaterial* mat = scene->mMaterials[scene->mMeshes[sceneMeshes[i]]->mMaterialIndex];
+		getMaterialTextures(mat, aiTextureType_DIFFUSE, "texture_diffuse", texturePaths, textureTypes);
+		getMaterialTextures(mat, aiTextureType_HEIGHT, "texture_normals", texturePaths, textureTypes);
+		getMaterialTextures(mat, aiTextureType_AMBIENT, "texture_ao", texturePaths, textureTypes);
+	}
+	firstTexture[numMeshes] = (unsigned int)texturePaths.size();
+
+	//meshes are independent once baseVertex is known, each job converts whole ones
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<std::vector<Vertex>> vertices(numMeshes);
+	std::vector<std::vector<unsigned int>> indices(numMeshes);
+	std::vector<double> meshMicros(numMeshes);
+	std::vector<VertexCacheStats> before(numMeshes), after(numMeshes);
+	jobs.parallelFor(numMeshes, 1, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; i++) {
+			std::chrono::high_resolution_clock::time_point meshStart = std::chrono::high_resolution_clock::now();
+			processMesh(scene->mMeshes[sceneMeshes[i]], vertices[i], indices[i]);
+			//each mesh's weights are its own slice of bones, so meshes can be reordered side by side
+			if (settings.optimizeGeometry)
+				optimizeMesh(vertices[i], indices[i], bones.data() + baseVertex[sceneMeshes[i]], before[i], after[i]);
+			meshMicros[i] = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - meshStart).count();
+		}
+	});
+	loadTimes.cpuMillis += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	for (unsigned int i = 0; i < numMeshes; i++) {
+		loadTimes.workMillis += meshMicros[i] / 1000.0;
+	}
+
+	if (settings.optimizeGeometry) {
+		VertexCacheStats totalBefore, totalAfter;
+		for (unsigned int i = 0; i < numMeshes; i++) {
+			addVertexCacheStats(totalBefore, before[i]);
+			addVertexCacheStats(totalAfter, after[i]);
+		}
+		std::cout << "Geometry optimizer" << (settings.optimizeOverdraw ? " with overdraw sort" : "") << ": ACMR " << totalBefore.acmr
+			<< " -> " << totalAfter.acmr << ", ATVR " << totalBefore.atvr << " -> " << totalAfter.atvr << std::endl;
+	}
+
+	std::vector<unsigned int> textures = loadTextures(texturePaths, textureTypes, jobs);
+
+	geometry.setBones(bones);
+	std::vector<MeshRange> ranges(numMeshes);
+	for (unsigned int i = 0; i < numMeshes; i++) {
+		ranges[i] = geometry.addMesh(baseVertex[sceneMeshes[i]], vertices[i], indices[i]);
+	}
+	pendingMeshes.resize(meshOrder.size());
+	for (unsigned int i = 0; i < meshOrder.size(); i++) {
+		unsigned int slot = meshSlot[i];
+		pendingMeshes[i].range = ranges[slot];
+		pendingMeshes[i].textures.assign(textures.begin() + firstTexture[slot], textures.begin() + firstTexture[slot + 1]);
+	}
+
+	return true;
+}
+
+bool Model::readCooked(const std::string &cookedPath, unsigned long long sourceHash, double &coldMillis, JobSystem &jobs) {
+	CacheReader reader;
+	if (!reader.load(cookedPath))
+		return false;
+
+	char magic[sizeof(COOKED_MAGIC)];
+	reader.readBytes(magic, sizeof(magic));
+	bool current = std::memcmp(magic, COOKED_MAGIC, sizeof(magic)) == 0;
+	current = current && reader.read<unsigned int>() == COOKED_VERSION;
+	current = current && reader.read<unsigned int>() == sizeof(Vertex);
+	current = current && reader.read<unsigned int>() == sizeof(VertexBoneData);
+	current = current && reader.read<unsigned int>() == importFlags(settings.profile);
+	current = current && reader.read<unsigned int>() == geometryFlags();
+	current = current && reader.read<unsigned long long>() == sourceHash;
+	if (reader.failed() || !current) {
+		std::cout << "Cooked model " << cookedPath << " is out of date, importing the source again." << std::endl;
+		return false;
+	}
+	coldMillis = reader.read<double>();
+
+	Animator* cookedAnimator = new Animator(reader);
+	std::vector<Vertex> cookedVertices;
+	std::vector<unsigned int> cookedIndices;
+	std::vector<VertexBoneData> cookedBones;
+	reader.readArray(cookedVertices);
+	reader.readArray(cookedIndices);
+	reader.readArray(cookedBones);
+
+	//everything is read before anything is decoded, so a damaged file leaves nothing to undo
+	struct CookedMesh {
+		MeshRange range;
+		std::vector<std::string> textureTypes;
+		std::vector<std::string> texturePaths;
+	};
+	std::vector<CookedMesh> cookedMeshes(reader.readCount());
+	bool rangesValid = true;
+	for (unsigned int i = 0; i < cookedMeshes.size() && !reader.failed(); i++) {
+		MeshRange &range = cookedMeshes[i].range;
+		range = reader.read<MeshRange>();
+		rangesValid = rangesValid && (size_t)range.firstIndex + range.numIndices <= cookedIndices.size();
+		rangesValid = rangesValid && (size_t)range.baseVertex + range.numVertices <= cookedVertices.size();
+		cookedMeshes[i].textureTypes.resize(reader.readCount());
+		cookedMeshes[i].texturePaths.resize(cookedMeshes[i].textureTypes.size());
+		for (unsigned int j = 0; j < cookedMeshes[i].textureTypes.size(); j++) {
+			cookedMeshes[i].textureTypes[j] = reader.readString();
+			cookedMeshes[i].texturePaths[j] = reader.readString();
+		}
+	}
+
+	if (reader.failed() || !rangesValid) {
+		std::cout << "Cooked model " << cookedPath << " is damaged, importing the source again." << std::endl;
+		delete cookedAnimator;
+		return false;
+	}
+
+	animator = cookedAnimator;
+	totalVertices = (unsigned int)cookedVertices.size();
+	geometry.setBones(cookedBones);
+
+	std::vector<std::string> texturePaths, textureTypes;
+	for (unsigned int i = 0; i < cookedMeshes.size(); i++) {
+		texturePaths.insert(texturePaths.end(), cookedMeshes[i].texturePaths.begin(), cookedMeshes[i].texturePaths.end());
+		textureTypes.insert(textureTypes.end(), cookedMeshes[i].textureTypes.begin(), cookedMeshes[i].textureTypes.end());
+	}
+	std::vector<unsigned int> textures = loadTextures(texturePaths, textureTypes, jobs);
+
+	unsigned int firstTexture = 0;
+	pendingMeshes.resize(cookedMeshes.size());
+	for (unsigned int i = 0; i < cookedMeshes.size(); i++) {
+		unsigned int numTextures = (unsigned int)cookedMeshes[i].texturePaths.size();
+		pendingMeshes[i].range = cookedMeshes[i].range;
+		pendingMeshes[i].textures.assign(textures.begin() + firstTexture, textures.begin() + firstTexture + numTextures);
+		firstTexture += numTextures;
+	}
+	geometry.setGeometry(cookedVertices, cookedIndices);
+
+	return true;
+}
+
+void Model::writeCooked(const std::string &cookedPath, unsigned long long sourceHash, double coldMillis) const {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	CacheWriter writer;
+	writer.writeBytes(COOKED_MAGIC, sizeof(COOKED_MAGIC));
+	writer.write(COOKED_VERSION);
+	writer.write((unsigned int)sizeof(Vertex));
+	writer.write((unsigned int)sizeof(VertexBoneData));
+	writer.write(importFlags(settings.profile));
+	writer.write(geometryFlags());
+	writer.write(sourceHash);
+	writer.write(coldMillis);
+
+	animator->write(writer);
+	writer.writeArray(geometry.getVertices());
+	writer.writeArray(geometry.getIndices());
+	writer.writeArray(geometry.getBones());
+
+	writer.write((unsigned long long)pendingMeshes.size());
+	for (unsigned int i = 0; i < pendingMeshes.size(); i++) {
+		writer.write(pendingMeshes[i].range);
+
+		const std::vector<unsigned int>& textures = pendingMeshes[i].textures;
+		writer.write((unsigned long long)textures.size());
+		for (unsigned int j = 0; j < textures.size(); j++) {
+			writer.writeString(loaded_textures[textures[j]].type);
+			writer.writeString(loaded_textures[textures[j]].path);
+		}
+	}
+
+	if (!writer.save(cookedPath)) {
+		std::cout << "Could not write cooked model " << cookedPath << std::endl;
+		return;
+	}
+
+	double writeMillis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "Cooked " << cookedPath << ": " << writer.getSize() / 1024 << " KB in " << writeMillis << " ms" << std::endl;
+}
+
+void Model::setupAnimation() {
+	if (settings.bakeRate > 0.0f && animator->getNumClips() > 0) {
+		BakeReport report = animator->bake(settings.bakeRate);
+		std::cout << "Baked animation at " << settings.bakeRate << " samples/s: " << report.numFrames << " frames, "
+			<< report.bytes / 1024 << " KB, max error: position " << report.maxPositionError
+			<< ", rotation " << report.maxRotationError << " deg, scale " << report.maxScaleError
+			<< ", simd sampler " << report.maxSamplerDifference << std::endl;
+	}
+
+	defaultInstance = animator->createInstance();
+
+	if (settings.skinning == SKINNING_DUAL_QUATERNION) {
+		dualPalette.resize(defaultInstance.palette.size());
+		std::cout << "Dual quaternion skinning: " << sizeof(glm::dualquat) << " bytes per bone, "
+			<< dualPalette.size() * sizeof(glm::dualquat) << " bytes per palette upload (linear blend: "
+			<< defaultInstance.palette.size() * sizeof(Affine) << ")" << std::endl;
+	}
+
+	if (settings.paletteBudget > 0 && animator->getNumClips() > 0) {
+		PaletteBakeReport report = animator->bakePalettes(settings.paletteRate, settings.paletteBudget);
+		std::cout << "Baked skinning palettes for " << report.clipsBaked << " of " << animator->getNumClips() << " animations: "
+			<< report.bytes / 1024 << " KB of " << settings.paletteBudget / 1024 << " KB budget, "
+			<< report.evaluateMicros << " us per evaluated pose vs " << report.lookupMicros << " us per baked lookup" << std::endl;
+	}
+}
+
+void Model::createPaletteBlock() {
+	//linear blend palettes only go through the palette ring of drawInstanced
+	unsigned int numBones = animator->getNumBones();
+	if (numBones == 0 || settings.skinning != SKINNING_DUAL_QUATERNION)
+		return;
+
+	//std140 lays a mat2x4 out as two vec4 columns, the same bytes as dualquat
+	size_t boneBytes = sizeof(glm::dualquat);
+	GLint maxBlockSize = 0;
+	glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxBlockSize);
+
+	//a smaller block would leave the shaders indexing bones past MAX_BONES, so the uniform path is refused instead
+	if (numBones * boneBytes > (size_t)maxBlockSize) {
+		std::cout << "Skeleton has " << numBones << " bones but a uniform block only fits " << maxBlockSize / boneBytes
+			<< ", draw() is off for this model. Draw it with linear blend skinning and drawInstanced instead." << std::endl;
+		return;
+	}
+	paletteBlockBones = numBones;
 
-	processNode(scene->mRootNode, scene);
+	glGenBuffers(1, &paletteBlock);
+	glBindBuffer(GL_UNIFORM_BUFFER, paletteBlock);
+	glBufferData(GL_UNIFORM_BUFFER, paletteBlockBones * boneBytes, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
+void Model::collectMeshes(const aiNode* node, std::vector<unsigned int> &meshOrder) const {
 	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		animator->loadBones(i, mesh, bones, baseVertex);
-		meshes.push_back(processMesh(i, mesh, scene));
+		meshOrder.push_back(node->mMeshes[i]);
 	}
 
 	for (unsigned int i = 0; i < node->mNumChildren; i++) {
-		processNode(node->mChildren[i], scene);
+		collectMeshes(node->mChildren[i], meshOrder);
 	}
 }
 
-Mesh Model::processMesh(unsigned int meshId, aiMesh* mesh, const aiScene* scene) {
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+void Model::processMesh(const aiMesh* mesh, std::vector<Vertex> &vertices, std::vector<unsigned int> &indices) const {
+	vertices.reserve(mesh->mNumVertices);
+	indices.reserve(mesh->mNumFaces * 3);
 
 	Vertex vertex;
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
@@ -75,53 +619,82 @@ Mesh Model::processMesh(unsigned int meshId, aiMesh* mesh, const aiScene* scene)
 	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
 		for(unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++)
 			indices.push_back(mesh->mFaces[i].mIndices[j]);
+}
 
-	if (mesh->mMaterialIndex >= 0) {
-		aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
-		std::vector<Texture> diffuseMaps = getMaterialTextures(mat, aiTextureType_DIFFUSE, "texture_diffuse");
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+void Model::optimizeMesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, VertexBoneData* bones, VertexCacheStats &before, VertexCacheStats &after) const {
+	unsigned int numVertices = (unsigned int)vertices.size();
+	before = simulateVertexCache(indices.data(), indices.size(), numVertices);
 
-		std::vector<Texture> normalMaps = getMaterialTextures(mat, aiTextureType_HEIGHT, "texture_normals");
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+	optimizeVertexCache(indices.data(), indices.size(), numVertices);
+	if (settings.optimizeOverdraw)
+		optimizeOverdraw(indices.data(), indices.size(), vertices.data(), numVertices);
 
-		std::vector<Texture> aoMaps = getMaterialTextures(mat, aiTextureType_AMBIENT, "texture_ao");
-		textures.insert(textures.end(), aoMaps.begin(), aoMaps.end());
-	}
+	std::vector<unsigned int> remap = optimizeVertexFetch(indices.data(), indices.size(), numVertices);
+	remapVertices(vertices.data(), remap);
+	remapVertices(bones, remap);
+
+	after = simulateVertexCache(indices.data(), indices.size(), numVertices);
+}
 
-	return Mesh(vertices, indices, textures, bones);
+unsigned int Model::geometryFlags() const {
+	//settings that change what ends up in the arena, part of the cooked header like the import flags
+	return (settings.optimizeGeometry ? 1u : 0u) | (settings.optimizeGeometry && settings.optimizeOverdraw ? 2u : 0u);
 }
 
-std::vector<Texture> Model::getMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
-	std::vector<Texture> textures;
-	Texture texture;
+void Model::getMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName, std::vector<std::string> &paths, std::vector<std::string> &types) const {
 	aiString str;
-	bool skip;
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
 		mat->GetTexture(type, i, &str);
-		skip = false;
-		for (unsigned int j = 0; j < loaded_textures.size(); j++) {
-			if (std::strcmp(loaded_textures[j].path.data(), str.C_Str()) == 0) {
-				textures.push_back(loaded_textures[j]);
-				skip = true;
-				break;
-			}
-		}
+		paths.push_back(str.C_Str());
+		types.push_back(typeName);
+	}
+}
 
-		if (!skip) {
-			texture.id = textureFromFile(str.C_Str(), this->dir);
-			texture.type = typeName;
-			texture.path = str.C_Str();
-			textures.push_back(texture);
+std::vector<unsigned int> Model::loadTextures(const std::vector<std::string> &paths, const std::vector<std::string> &types, JobSystem &jobs) {
+	//files already loaded, or named earlier in this batch, are only decoded once
+	std::vector<unsigned int> slots(paths.size());
+	unsigned int firstNew = (unsigned int)loaded_textures.size();
+	for (unsigned int i = 0; i < paths.size(); i++) {
+		unsigned int j = 0;
+		while (j < loaded_textures.size() && loaded_textures[j].path != paths[i])
+			j++;
+		if (j == loaded_textures.size()) {
+			Texture texture;
+			texture.id = 0;
+			texture.type = types[i];
+			texture.path = paths[i];
 			loaded_textures.push_back(texture);
 		}
+		slots[i] = j;
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	unsigned int numDecodes = (unsigned int)loaded_textures.size() - firstNew;
+	textureImages.resize(loaded_textures.size());
+	std::vector<double> decodeMicros(numDecodes);
+	jobs.parallelFor(numDecodes, 1, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; i++) {
+			std::chrono::high_resolution_clock::time_point imageStart = std::chrono::high_resolution_clock::now();
+			textureImages[firstNew + i] = decodeTexture(loaded_textures[firstNew + i].path, dir);
+			decodeMicros[i] = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - imageStart).count();
+		}
+	});
+
+	for (unsigned int i = 0; i < numDecodes; i++) {
+		loadTimes.workMillis += decodeMicros[i] / 1000.0;
 	}
+	loadTimes.cpuMillis += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return slots;
+}
 
-	return textures;
+TextureImage decodeTexture(const std::string &path, const std::string &dir) {
+	std::string filename = dir + '/' + path;
+	TextureImage image;
+	image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.channels, 0);
+	return image;
 }
 
-unsigned int textureFromFile(const char* path, const std::string& dir) {
-	std::string filename = std::string(path);
-	filename = dir + '/' + filename;
+unsigned int uploadTexture(TextureImage &image, const std::string &path) {
 	unsigned int id;
 	glGenTextures(1, &id);
 	glBindTexture(GL_TEXTURE_2D, id);
@@ -131,11 +704,9 @@ unsigned int textureFromFile(const char* path, const std::string& dir) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	int width, height, nrChannels;
-	unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
-	if (data) {
+	if (image.data) {
 		GLenum format;
-		switch (nrChannels) {
+		switch (image.channels) {
 			case 1:
 				format = GL_RED;
 				break;
@@ -147,13 +718,14 @@ unsigned int textureFromFile(const char* path, const std::string& dir) {
 				break;
 		}
 
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
 		glGenerateMipmap(GL_TEXTURE_2D);
 	}
 	else
 		std::cout << "Could not load model texture: " << path << std::endl;
 
-	stbi_image_free(data);
+	stbi_image_free(image.data);
+	image.data = NULL;
 
 	return id;
 }
@@ -162,10 +734,75 @@ glm::vec3 getVec(aiVector3D el) {
 	return glm::vec3(el.x, el.y, el.z); 
 }
 
-void Model::playAnimation(float time, Shader &shader) {
-	std::vector<glm::mat4> transforms;
+bool Model::setAnimation(const std::string &name) {
+	return setAnimation(defaultInstance, name);
+}
+
+void Model::setPoseCache(PoseCache* cache) {
+	defaultInstance.poseCache = cache;
+}
+
+void Model::playAnimation(float time) {
+	playAnimation(defaultInstance, time);
+}
+
+AnimationInstance Model::createInstance() const {
+	return animator->createInstance();
+}
+
+bool Model::setAnimation(AnimationInstance &instance, const std::string &name) const {
+	int clipId = animator->findClip(name);
+	if (clipId < 0) {
+		std::cout << "Could not find animation: " << name << std::endl;
+		return false;
+	}
+
+	//cursors are not reset here, stale ones just fall back to a binary search on the first sample
+	instance.clip = clipId;
+	return true;
+}
+
+void Model::playAnimation(AnimationInstance &instance, float time) {
+	if (instance.palette.empty())
+		return;
+
+	animator->update(instance, time);
+	uploadPalette(instance);
+}
+
+void Model::uploadPalette(const AnimationInstance &instance) {
+	if (!instance.palette.empty())
+		uploadPalette(&instance.palette[0]);
+}
+
+void Model::uploadPalette(const Affine* palette) {
+	if (paletteBlock == 0)
+		return;
+
+	//other models share the binding point, so it is claimed again on every upload
+	glBindBufferBase(GL_UNIFORM_BUFFER, PALETTE_BLOCK_BINDING, paletteBlock);
+
+	for (unsigned int i = 0; i < paletteBlockBones; i++) {
+		dualPalette[i] = affineToDualQuat(palette[i]);
+	}
+
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, paletteBlockBones * sizeof(glm::dualquat), &dualPalette[0]);
+	drawStats.uploadBytes += paletteBlockBones * sizeof(glm::dualquat);
+}
+
+std::string Model::getShaderDefines() const {
+	//an empty array won't compile, bone-less models still get one
+	return "#define MAX_BONES " + std::to_string(std::max(paletteBlockBones, 1u)) + "\n";
+}
+
+unsigned int Model::getNumBones() const {
+	return animator->getNumBones();
+}
 
-	transforms = animator->boneTransform(time, transforms);
+const Animator& Model::getAnimator() const {
+	return *animator;
+}
 
-	glUniformMatrix4fv(glGetUniformLocation(shader.id, "bones"), (GLsizei)transforms.size(), GL_FALSE, glm::value_ptr(transforms[0]));
+SkinningMode Model::getSkinningMode() const {
+	return settings.skinning;
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "ModelCache.h"
+
+#include <fstream>
+#include <cstdio>
+
+const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+unsigned long long hashFile(const std::string &path, unsigned long long hash) {
+	std::ifstream file(path, std::ios::binary);
+	char buffer[65536];
+	while (file) {
+		file.read(buffer, sizeof(buffer));
+		std::streamsize count = file.gcount();
+		for (std::streamsize i = 0; i < count; i++) {
+			hash ^= (unsigned char)buffer[i];
+			hash *= FNV_PRIME;
+		}
+	}
+
+	return hash;
+}
+
+unsigned long long hashModelSource(const std::string &path) {
+	unsigned long long hash = hashFile(path);
+
+	//assimp's md5 loader pulls the animation in from the sibling file on its own
+	size_t extension = path.find_last_of('.');
+	if (extension != std::string::npos && path.substr(extension) == ".md5mesh")
+		hash = hashFile(path.substr(0, extension) + ".md5anim", hash);
+
+	return hash;
+}
+
+void CacheWriter::writeBytes(const void* bytes, size_t size) {
+	const char* begin = (const char*)bytes;
+	data.insert(data.end(), begin, begin + size);
+}
+
+void CacheWriter::writeString(const std::string &value) {
+	write((unsigned long long)value.size());
+	writeBytes(value.data(), value.size());
+}
+
+size_t CacheWriter::getSize() const {
+	return data.size();
+}
+
+bool CacheWriter::save(const std::string &path) const {
+	//written next to the real file and renamed over it, so a crash never leaves half a cooked file behind
+	std::string temp = path + ".tmp";
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+		file.write(data.data(), data.size());
+		if (!file)
+			return false;
+	}
+
+	std::remove(path.c_str());
+	return std::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+bool CacheReader::load(const std::string &path) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	std::streamsize size = file.tellg();
+	file.seekg(0);
+	data.resize((size_t)size);
+	offset = 0;
+	fail = !file.read(data.data(), size);
+	return !fail;
+}
+
+void CacheReader::readBytes(void* bytes, size_t size) {
+	if (fail || size > data.size() - offset) {
+		fail = true;
+		return;
+	}
+
+	std::memcpy(bytes, &data[offset], size);
+	offset += size;
+}
+
+std::string CacheReader::readString() {
+	unsigned long long size = read<unsigned long long>();
+	if (fail || size > data.size() - offset) {
+		fail = true;
+		return std::string();
+	}
+
+	std::string value(&data[offset], (size_t)size);
+	offset += (size_t)size;
+	return value;
+}
+
+size_t CacheReader::readCount() {
+	unsigned long long count = read<unsigned long long>();
+	if (fail || count > data.size() - offset) {
+		fail = true;
+		return 0;
+	}
+
+	return (size_t)count;
+}
+
+bool CacheReader::failed() const {
+	return fail;
+}
+
+void CacheReader::setFailed() {
+	fail = true;
+}
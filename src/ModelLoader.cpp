@@ -0,0 +1,164 @@
+#include "ModelLoader.h"
+
+#include <algorithm>
+#include <chrono>
+
+//most a single uploadSome call is asked for, so the time budget is checked every few hundred microseconds
+const size_t UPLOAD_CHUNK_BYTES = 256 * 1024;
+
+ModelLoad::ModelLoad(const std::string &path, const ModelSettings &settings) : path(path), settings(settings), state(MODEL_PENDING), cancelled(false) {
+}
+
+ModelHandle::ModelHandle() {
+}
+
+ModelHandle::ModelHandle(const std::shared_ptr<ModelLoad> &load) : load(load) {
+}
+
+ModelLoadState ModelHandle::getState() const {
+	return load ? load->state.load() : MODEL_CANCELLED;
+}
+
+Model* ModelHandle::get() const {
+	//the state is written after the model, so a resident one is seen whole
+	if (!load || load->state.load() != MODEL_RESIDENT)
+		return NULL;
+	return load->model.get();
+}
+
+void ModelHandle::cancel() {
+	if (load)
+		load->cancelled = true;
+}
+
+bool ModelHandle::isValid() const {
+	return load != NULL;
+}
+
+ModelLoader::ModelLoader(unsigned int numThreads) : jobs(numThreads) {
+	worker = std::thread(&ModelLoader::workerLoop, this);
+}
+
+ModelLoader::~ModelLoader() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	worker.join();
+
+	//partly uploaded models delete their gl objects here, on the gl thread
+	for (unsigned int i = 0; i < pending.size(); i++) {
+		pending[i]->state = MODEL_CANCELLED;
+	}
+	for (unsigned int i = 0; i < uploads.size(); i++) {
+		uploads[i]->model.reset();
+		uploads[i]->state = MODEL_CANCELLED;
+	}
+}
+
+ModelHandle ModelLoader::load(const std::string &path, const ModelSettings &settings) {
+	std::shared_ptr<ModelLoad> load = std::make_shared<ModelLoad>(path, settings);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending.push_back(load);
+	}
+	wake.notify_one();
+
+	return ModelHandle(load);
+}
+
+const UploadReport& ModelLoader::update(size_t maxBytes, double maxMillis) {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	UploadReport report;
+
+	bool stepped = false;
+	while (true) {
+		std::shared_ptr<ModelLoad> load;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (uploads.empty())
+				break;
+			load = uploads.front();
+		}
+
+		//the queue and this function are the only owners left when every handle is gone
+		if (load->cancelled || load.use_count() <= 2) {
+			load->model.reset();
+			load->state = MODEL_CANCELLED;
+			std::lock_guard<std::mutex> lock(mutex);
+			uploads.pop_front();
+			continue;
+		}
+
+		double millis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		if (stepped && (report.bytes >= maxBytes || millis >= maxMillis))
+			break;
+
+		size_t budget = std::min(std::max(maxBytes - report.bytes, (size_t)1), UPLOAD_CHUNK_BYTES);
+		report.bytes += load->model->uploadSome(budget);
+		stepped = true;
+
+		if (load->model->isResident()) {
+			load->state = MODEL_RESIDENT;
+			report.modelsResident++;
+			std::lock_guard<std::mutex> lock(mutex);
+			uploads.pop_front();
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		report.modelsWaiting = (unsigned int)uploads.size();
+	}
+	report.millis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	lastUpdate = report;
+	return lastUpdate;
+}
+
+const UploadReport& ModelLoader::getLastUpdate() const {
+	return lastUpdate;
+}
+
+void ModelLoader::workerLoop() {
+	while (true) {
+		std::shared_ptr<ModelLoad> load;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return quit || !pending.empty(); });
+			if (quit)
+				return;
+			load = pending.front();
+			pending.pop_front();
+		}
+
+		if (load->cancelled || load.use_count() == 1) {
+			load->state = MODEL_CANCELLED;
+			continue;
+		}
+
+		//the cpu stage makes no gl calls, so a model thrown away here has nothing to delete on the gl thread
+		ModelSettings settings = load->settings;
+		settings.jobs = &jobs;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		std::unique_ptr<Model> model(new Model(load->path.c_str(), settings, false));
+		double millis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		if (model->hasFailed()) {
+			std::cout << "Streaming " << load->path << " failed" << std::endl;
+			load->state = MODEL_FAILED;
+			continue;
+		}
+		if (load->cancelled) {
+			load->state = MODEL_CANCELLED;
+			continue;
+		}
+
+		std::cout << "Streamed " << load->path << " into memory in " << millis << " ms off the gl thread, "
+			<< model->getGeometry().getCpuBytes() / 1024 << " KB of geometry queued for upload" << std::endl;
+		load->model = std::move(model);
+		load->state = MODEL_CPU_READY;
+		std::lock_guard<std::mutex> lock(mutex);
+		uploads.push_back(load);
+	}
+}
@@ -0,0 +1,141 @@
+#include "PaletteRing.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <GLFW/glfw3.h>
+
+//regions start big enough for a few hundred 33 bone characters and double whenever a frame needs more
+const size_t PALETTE_RING_MIN_REGION = 16384;
+
+PaletteRing::PaletteRing() {
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+	if (major > 4 || (major == 4 && minor >= 4) || glfwExtensionSupported("GL_ARB_buffer_storage"))
+		bufferStorage = (BufferStorageProc)glfwGetProcAddress("glBufferStorage");
+
+	if (!bufferStorage)
+		std::cout << "No glBufferStorage, streaming palettes with glBufferSubData." << std::endl;
+
+	//GL 3.3 only promises 65536 texels, three of them per Affine, and the whole ring is one texture buffer
+	GLint maxTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	maxRegionSize = std::max((size_t)maxTexels / 3 / PALETTE_RING_REGIONS, (size_t)1);
+}
+
+PaletteRing::~PaletteRing() {
+	release();
+}
+
+void PaletteRing::allocate(size_t count) {
+	release();
+
+	regionSize = std::min(std::max(count, PALETTE_RING_MIN_REGION), maxRegionSize);
+	GLsizeiptr bytes = (GLsizeiptr)(regionSize * PALETTE_RING_REGIONS * sizeof(Affine));
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	if (bufferStorage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		bufferStorage(GL_TEXTURE_BUFFER, bytes, NULL, flags);
+		mapped = (Affine*)glMapBufferRange(GL_TEXTURE_BUFFER, 0, bytes, flags);
+	}
+	else {
+		glBufferData(GL_TEXTURE_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+		staging.resize(regionSize);
+	}
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void PaletteRing::release() {
+	if (buffer == 0)
+		return;
+
+	for (unsigned int i = 0; i < PALETTE_RING_REGIONS; i++) {
+		waitRegion(i);
+	}
+
+	if (mapped) {
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+		glUnmapBuffer(GL_TEXTURE_BUFFER);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		mapped = NULL;
+	}
+
+	glDeleteTextures(1, &texture);
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+	texture = 0;
+}
+
+void PaletteRing::waitRegion(unsigned int region) {
+	if (!fences[region])
+		return;
+
+	//a zero timeout first, so stalls can be told apart from fences that had already passed
+	GLenum result = glClientWaitSync(fences[region], 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		stalls++;
+		do {
+			result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+
+	glDeleteSync(fences[region]);
+	fences[region] = 0;
+}
+
+Affine* PaletteRing::map(size_t count) {
+	assert(count <= maxRegionSize);
+	if (buffer == 0 || count > regionSize)
+		allocate(std::max(count, regionSize * 2));
+
+	region = (region + 1) % PALETTE_RING_REGIONS;
+	waitRegion(region);
+	mappedCount = count;
+
+	if (mapped)
+		return mapped + region * regionSize;
+	return &staging[0];
+}
+
+int PaletteRing::unmap() {
+	size_t first = region * regionSize;
+	if (!mapped) {
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+		glBufferSubData(GL_TEXTURE_BUFFER, first * sizeof(Affine), mappedCount * sizeof(Affine), &staging[0]);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	//three RGBA32F texels per Affine
+	return (int)(first * 3);
+}
+
+void PaletteRing::fence() {
+	if (fences[region])
+		glDeleteSync(fences[region]);
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+unsigned int PaletteRing::getTexture() const {
+	return texture;
+}
+
+size_t PaletteRing::getMaxCount() const {
+	return maxRegionSize;
+}
+
+bool PaletteRing::isPersistent() const {
+	return bufferStorage != NULL;
+}
+
+unsigned long long PaletteRing::getStalls() const {
+	return stalls;
+}
@@ -0,0 +1,81 @@
+#include "PoseCache.h"
+
+#include <algorithm>
+#include <iterator>
+
+PoseCache::PoseCache(unsigned int capacity, float samplesPerSecond) {
+	this->capacity = std::max(capacity, 1u);
+	this->samplesPerSecond = samplesPerSecond;
+	lookup.reserve(this->capacity);
+}
+
+unsigned int PoseCache::quantize(float timeInSeconds) const {
+	return (unsigned int)(timeInSeconds * samplesPerSecond);
+}
+
+float PoseCache::sampleTime(unsigned int sample) const {
+	return (float)sample / samplesPerSecond;
+}
+
+bool PoseCache::fetch(const PoseKey &key, Affine* palette, unsigned int paletteSize) {
+	std::unordered_map<PoseKey, std::list<Entry>::iterator, PoseKeyHash>::iterator found = lookup.find(key);
+	if (found == lookup.end()) {
+		misses++;
+		return false;
+	}
+
+	const std::vector<Affine>& cached = found->second->palette;
+	std::copy(cached.begin(), cached.begin() + std::min((unsigned int)cached.size(), paletteSize), palette);
+	entries.splice(entries.begin(), entries, found->second);
+	hits++;
+	return true;
+}
+
+void PoseCache::store(const PoseKey &key, const Affine* palette, unsigned int paletteSize) {
+	std::unordered_map<PoseKey, std::list<Entry>::iterator, PoseKeyHash>::iterator found = lookup.find(key);
+	if (found != lookup.end()) {
+		found->second->palette.assign(palette, palette + paletteSize);
+		entries.splice(entries.begin(), entries, found->second);
+		return;
+	}
+
+	//once full, the least recently used entry is recycled so its palette storage is reused
+	if (entries.size() >= capacity) {
+		lookup.erase(entries.back().key);
+		entries.splice(entries.begin(), entries, std::prev(entries.end()));
+	}
+	else {
+		entries.push_front(Entry());
+	}
+
+	Entry& entry = entries.front();
+	entry.key = key;
+	entry.palette.assign(palette, palette + paletteSize);
+	lookup[key] = entries.begin();
+}
+
+void PoseCache::clear() {
+	entries.clear();
+	lookup.clear();
+	hits = 0;
+	misses = 0;
+}
+
+unsigned long long PoseCache::getHits() const {
+	return hits;
+}
+
+unsigned long long PoseCache::getMisses() const {
+	return misses;
+}
+
+unsigned int PoseCache::getSize() const {
+	return (unsigned int)entries.size();
+}
+
+size_t PoseCache::getBytes() const {
+	size_t bytes = 0;
+	for (std::list<Entry>::const_iterator entry = entries.begin(); entry != entries.end(); entry++)
+		bytes += sizeof(Entry) + entry->palette.capacity() * sizeof(Affine);
+	return bytes;
+}
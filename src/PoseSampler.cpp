@@ -0,0 +1,100 @@
+#include "PoseSampler.h"
+
+#include <cmath>
+
+#if !defined(POSE_SAMPLER_SCALAR)
+#	if defined(__AVX__)
+#		include <immintrin.h>
+#		define POSE_SAMPLER_AVX
+#	elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#		include <emmintrin.h>
+#		define POSE_SAMPLER_SSE
+#	endif
+#endif
+
+void samplePoseScalar(const float* current, const float* next, float factor, unsigned int stride, float* out) {
+	unsigned int size = POSE_NUM_STREAMS * stride;
+	for (unsigned int i = 0; i < size; i++) {
+		out[i] = current[i] + (next[i] - current[i]) * factor;
+	}
+
+	float* x = out + POSE_ROTATION_X * stride;
+	float* y = out + POSE_ROTATION_Y * stride;
+	float* z = out + POSE_ROTATION_Z * stride;
+	float* w = out + POSE_ROTATION_W * stride;
+	for (unsigned int i = 0; i < stride; i++) {
+		float invLength = 1.0f / std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i] + w[i] * w[i]);
+		x[i] *= invLength;
+		y[i] *= invLength;
+		z[i] *= invLength;
+		w[i] *= invLength;
+	}
+}
+
+#if defined(POSE_SAMPLER_AVX)
+
+void samplePoseSimd(const float* current, const float* next, float factor, unsigned int stride, float* out) {
+	unsigned int size = POSE_NUM_STREAMS * stride;
+	__m256 f = _mm256_set1_ps(factor);
+	for (unsigned int i = 0; i < size; i += 8) {
+		__m256 a = _mm256_loadu_ps(current + i);
+		__m256 b = _mm256_loadu_ps(next + i);
+		_mm256_storeu_ps(out + i, _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), f)));
+	}
+
+	float* x = out + POSE_ROTATION_X * stride;
+	float* y = out + POSE_ROTATION_Y * stride;
+	float* z = out + POSE_ROTATION_Z * stride;
+	float* w = out + POSE_ROTATION_W * stride;
+	__m256 one = _mm256_set1_ps(1.0f);
+	for (unsigned int i = 0; i < stride; i += 8) {
+		__m256 qx = _mm256_loadu_ps(x + i);
+		__m256 qy = _mm256_loadu_ps(y + i);
+		__m256 qz = _mm256_loadu_ps(z + i);
+		__m256 qw = _mm256_loadu_ps(w + i);
+		__m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(qx, qx), _mm256_mul_ps(qy, qy)), _mm256_add_ps(_mm256_mul_ps(qz, qz), _mm256_mul_ps(qw, qw)));
+		__m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSq));
+		_mm256_storeu_ps(x + i, _mm256_mul_ps(qx, invLength));
+		_mm256_storeu_ps(y + i, _mm256_mul_ps(qy, invLength));
+		_mm256_storeu_ps(z + i, _mm256_mul_ps(qz, invLength));
+		_mm256_storeu_ps(w + i, _mm256_mul_ps(qw, invLength));
+	}
+}
+
+#elif defined(POSE_SAMPLER_SSE)
+
+void samplePoseSimd(const float* current, const float* next, float factor, unsigned int stride, float* out) {
+	unsigned int size = POSE_NUM_STREAMS * stride;
+	__m128 f = _mm_set1_ps(factor);
+	for (unsigned int i = 0; i < size; i += 4) {
+		__m128 a = _mm_loadu_ps(current + i);
+		__m128 b = _mm_loadu_ps(next + i);
+		_mm_storeu_ps(out + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f)));
+	}
+
+	float* x = out + POSE_ROTATION_X * stride;
+	float* y = out + POSE_ROTATION_Y * stride;
+	float* z = out + POSE_ROTATION_Z * stride;
+	float* w = out + POSE_ROTATION_W * stride;
+	__m128 one = _mm_set1_ps(1.0f);
+	for (unsigned int i = 0; i < stride; i += 4) {
+		__m128 qx = _mm_loadu_ps(x + i);
+		__m128 qy = _mm_loadu_ps(y + i);
+		__m128 qz = _mm_loadu_ps(z + i);
+		__m128 qw = _mm_loadu_ps(w + i);
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)), _mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw)));
+		__m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+		_mm_storeu_ps(x + i, _mm_mul_ps(qx, invLength));
+		_mm_storeu_ps(y + i, _mm_mul_ps(qy, invLength));
+		_mm_storeu_ps(z + i, _mm_mul_ps(qz, invLength));
+		_mm_storeu_ps(w + i, _mm_mul_ps(qw, invLength));
+	}
+}
+
+#else
+
+void samplePoseSimd(const float* current, const float* next, float factor, unsigned int stride, float* out) {
+	samplePoseScalar(current, next, factor, stride, out);
+}
+
+#endif
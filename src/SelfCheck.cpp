@@ -0,0 +1,369 @@
+#include "SelfCheck.h"
+
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+
+//the two samplers do the same operations in the same order, only fused multiply-adds may round differently
+const float SAMPLER_TOLERANCE = 1e-5f;
+//float rounding of two different ways to the same rigid transform
+const float DUAL_QUAT_TOLERANCE = 1e-5f;
+//the 3x4 and 4x4 compositions round differently once a few joints deep
+const float AFFINE_TOLERANCE = 1e-5f;
+//bones whose rotation part is further than this from orthonormal carry scale, which dual quaternions drop
+const float RIGID_TOLERANCE = 1e-3f;
+
+//difference relative to the size of the values, so positions in the hundreds get the same slack as unit quaternions
+float relativeDifference(float a, float b) {
+	return std::abs(a - b) / std::max(std::max(std::abs(a), std::abs(b)), 1.0f);
+}
+
+bool reportCheck(const char* name, const std::string &compared, float difference, float tolerance) {
+	bool passed = difference <= tolerance;
+	std::cout << (passed ? "PASS " : "FAIL ") << name << ": " << compared << ", max difference " << difference
+		<< " (tolerance " << tolerance << ")" << std::endl;
+	return passed;
+}
+
+float compareSamplers(const float* current, const float* next, float factor, unsigned int stride, std::vector<float> &scalarPose, std::vector<float> &simdPose) {
+	unsigned int frameSize = POSE_NUM_STREAMS * stride;
+	scalarPose.resize(frameSize);
+	simdPose.resize(frameSize);
+	samplePoseScalar(current, next, factor, stride, scalarPose.data());
+	samplePoseSimd(current, next, factor, stride, simdPose.data());
+
+	float difference = 0.0f;
+	for (unsigned int i = 0; i < frameSize; i++)
+		difference = std::max(difference, relativeDifference(scalarPose[i], simdPose[i]));
+	return difference;
+}
+
+bool checkPoseSampler(const Animator &animator) {
+	const float factors[] = { 0.0f, 0.25f, 0.5f, 0.75f, 1.0f };
+	const unsigned int numFactors = sizeof(factors) / sizeof(factors[0]);
+	std::vector<float> scalarPose, simdPose;
+	float difference = 0.0f;
+	unsigned int numSamples = 0;
+
+	//random poses of a few sizes, rotations kept in one hemisphere like the baker does
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f), unit(-1.0f, 1.0f), scale(0.5f, 2.0f);
+	const unsigned int trackCounts[] = { 1, 7, 33, 100 };
+	for (unsigned int t = 0; t < sizeof(trackCounts) / sizeof(trackCounts[0]); t++) {
+		unsigned int stride = poseStride(trackCounts[t]);
+		std::vector<float> poses(2 * POSE_NUM_STREAMS * stride);
+		for (unsigned int frame = 0; frame < 2; frame++) {
+			for (unsigned int track = 0; track < stride; track++) {
+				glm::quat rotation = glm::normalize(glm::quat(std::abs(unit(random)) + 0.1f, unit(random), unit(random), unit(random)));
+				writePose(&poses[frame * POSE_NUM_STREAMS * stride], stride, track, glm::vec3(scale(random), scale(random), scale(random)),
+					rotation, glm::vec3(position(random), position(random), position(random)));
+			}
+		}
+
+		for (unsigned int f = 0; f < numFactors; f++, numSamples++)
+			difference = std::max(difference, compareSamplers(&poses[0], &poses[POSE_NUM_STREAMS * stride], factors[f], stride, scalarPose, simdPose));
+	}
+
+	//and whatever the model's clips were baked to
+	for (unsigned int c = 0; c < animator.getNumClips(); c++) {
+		const BakedClip &baked = animator.getClip(c).baked;
+		unsigned int frameSize = POSE_NUM_STREAMS * baked.stride;
+		if (frameSize == 0)
+			continue;
+
+		for (unsigned int frame = 0; frame + 1 < baked.numFrames; frame++) {
+			const float* current = baked.samples.data() + frame * frameSize;
+			for (unsigned int f = 0; f < numFactors; f++, numSamples++)
+				difference = std::max(difference, compareSamplers(current, current + frameSize, factors[f], baked.stride, scalarPose, simdPose));
+		}
+	}
+
+	return reportCheck("pose sampler", "simd against scalar over " + std::to_string(numSamples) + " samples", difference, SAMPLER_TOLERANCE);
+}
+
+#if defined(SELF_CHECK_ALLOCATIONS)
+bool checkPaletteAllocations(const Animator &animator) {
+	const unsigned int numSamples = 1000;
+	AnimationInstance instance = animator.createInstance();
+	std::vector<Affine> palette(animator.getNumBones());
+	unsigned long long allocations = 0;
+	unsigned int numClips = std::max(animator.getNumClips(), 1u);
+
+	for (unsigned int clip = 0; clip < numClips; clip++) {
+		instance.clip = clip;
+		//the first pose sizes the cursors and this thread's scratch buffers
+		animator.boneTransform(instance, 0.0f, palette.data(), (unsigned int)palette.size());
+		animator.update(instance, 0.0f);
+
+		unsigned long long before = getAllocationCount();
+		for (unsigned int i = 0; i < numSamples; i++) {
+			float time = i * 0.013f;
+			animator.boneTransform(instance, time, palette.data(), (unsigned int)palette.size());
+			animator.update(instance, time + 0.5f);
+		}
+		allocations += getAllocationCount() - before;
+	}
+
+	return reportCheck("palette allocations", "allocations over " + std::to_string(numSamples * 2 * numClips) + " evaluations",
+		(float)allocations, 0.0f);
+}
+#endif
+
+bool isRigid(const Affine &bone) {
+	glm::mat3 m(glm::vec3(bone.row[0]), glm::vec3(bone.row[1]), glm::vec3(bone.row[2]));
+	glm::mat3 product = m * glm::transpose(m);
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			if (std::abs(product[i][j] - (i == j ? 1.0f : 0.0f)) > RIGID_TOLERANCE)
+				return false;
+	return true;
+}
+
+float compareSkinning(const std::vector<Affine> &bones, std::mt19937 &random, unsigned int &numVertices) {
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f), weight(0.05f, 1.0f);
+	std::vector<glm::dualquat> dualBones(bones.size());
+	for (unsigned int i = 0; i < bones.size(); i++)
+		dualBones[i] = affineToDualQuat(bones[i]);
+
+	//a second copy with every dual quaternion negated, the same transform from the other hemisphere
+	std::vector<glm::dualquat> flipped(dualBones);
+	for (unsigned int i = 0; i < flipped.size(); i++)
+		flipped[i] = -flipped[i];
+	std::vector<glm::dualquat> both(dualBones);
+	both.insert(both.end(), flipped.begin(), flipped.end());
+
+	float difference = 0.0f;
+	unsigned int count = (unsigned int)bones.size();
+	for (unsigned int b = 0; b < count; b++) {
+		if (!isRigid(bones[b]))
+			continue;
+
+		for (unsigned int v = 0; v < 4; v++, numVertices++) {
+			glm::vec3 point(position(random), position(random), position(random));
+			glm::vec4 weights(weight(random), weight(random), weight(random), weight(random));
+			weights /= weights.x + weights.y + weights.z + weights.w;
+			glm::vec3 linear = skinLinear(bones.data(), glm::ivec4(b), weights, point);
+
+			//slot 0 keeps the original sign so the others are flipped into its hemisphere
+			glm::ivec4 ids(b, v & 1 ? b + count : b, v & 2 ? b + count : b, b + count);
+			glm::vec3 single = skinDualQuat(dualBones.data(), glm::ivec4(b), weights, point);
+			glm::vec3 split = skinDualQuat(both.data(), ids, weights, point);
+			//relative to the whole position, a component near zero next to large ones carries their rounding
+			float size = std::max(glm::length(linear), 1.0f);
+			difference = std::max(difference, glm::length(linear - single) / size);
+			difference = std::max(difference, glm::length(linear - split) / size);
+		}
+	}
+	return difference;
+}
+
+bool checkDualQuatSkinning(const Animator &animator) {
+	std::mt19937 random(5678);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f), unit(-1.0f, 1.0f);
+	unsigned int numVertices = 0;
+
+	std::vector<Affine> bones(100);
+	for (unsigned int i = 0; i < bones.size(); i++) {
+		glm::quat rotation = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+		bones[i] = affineFromTRS(glm::vec3(position(random), position(random), position(random)), rotation, glm::vec3(1.0f));
+	}
+	float difference = compareSkinning(bones, random, numVertices);
+
+	AnimationInstance instance = animator.createInstance();
+	std::vector<Affine> palette(animator.getNumBones());
+	for (unsigned int clip = 0; clip < animator.getNumClips() && !palette.empty(); clip++) {
+		instance.clip = clip;
+		for (unsigned int i = 0; i < 8; i++) {
+			animator.boneTransform(instance, i * 0.37f, palette.data(), (unsigned int)palette.size());
+			difference = std::max(difference, compareSkinning(palette, random, numVertices));
+		}
+	}
+
+	return reportCheck("dual quaternion skinning", "against linear blend over " + std::to_string(numVertices) + " rigid bone vertices",
+		difference, DUAL_QUAT_TOLERANCE);
+}
+
+//palette of clipId at animationTime, composed in 4x4 matrices
+void referencePalette(const Animator &animator, unsigned int clipId, float animationTime, std::vector<glm::mat4> &palette) {
+	const Skeleton &skeleton = *animator.getSkeleton();
+	const Clip &clip = animator.getClip(clipId);
+	std::vector<glm::mat4> globalTransforms(skeleton.getNumJoints());
+	palette.assign(skeleton.getNumBones(), glm::mat4(1.0f));
+
+	for (unsigned int i = 0; i < skeleton.getNumJoints(); i++) {
+		const Joint &joint = skeleton.getJoint(i);
+		glm::mat4 nodeTransformation = affineToMat4(joint.bindLocal);
+
+		int track = clip.jointTracks[i];
+		if (track >= 0) {
+			glm::vec3 scale, position;
+			glm::quat rotation;
+			KeyCursor cursor;
+			sampleTrack(clip.tracks[track], animationTime, cursor, scale, rotation, position);
+			nodeTransformation = glm::translate(glm::mat4(1.0f), position) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+		}
+
+		globalTransforms[i] = joint.parent < 0 ? nodeTransformation : globalTransforms[joint.parent] * nodeTransformation;
+		if (joint.boneId >= 0)
+			palette[joint.boneId] = globalTransforms[i] * affineToMat4(skeleton.getBone(joint.boneId).offset);
+	}
+}
+
+bool checkAffinePalette(const Animator &animator) {
+	const unsigned int numTimes = 16;
+	AnimationInstance instance = animator.createInstance();
+	std::vector<Affine> palette(animator.getNumBones());
+	std::vector<glm::mat4> reference;
+	float difference = 0.0f;
+	unsigned int numPalettes = 0;
+
+	for (unsigned int c = 0; c < animator.getNumClips() && !palette.empty(); c++) {
+		const Clip &clip = animator.getClip(c);
+		instance.clip = c;
+		float framesPerTick = clip.palettes.numFrames > 0 ? clip.palettes.framesPerTick : clip.baked.framesPerTick;
+		unsigned int numFrames = clip.palettes.numFrames > 0 ? clip.palettes.numFrames : clip.baked.numFrames;
+
+		for (unsigned int t = 0; t < numTimes; t++, numPalettes++) {
+			float ticks = numFrames > 0 ? (float)(t * 7 % numFrames) / framesPerTick : t * (float)clip.duration / numTimes;
+			float seconds = ticks / clip.ticksPerSecond;
+			//the same time boneTransform plays
+			float animationTime = clip.duration > 0.0 ? std::fmod(seconds * clip.ticksPerSecond, (float)clip.duration) : 0.0f;
+
+			animator.boneTransform(instance, seconds, palette.data(), (unsigned int)palette.size());
+			referencePalette(animator, c, animationTime, reference);
+
+			//relative to the bone's largest entry, so translations in the hundreds don't dwarf the rotation part
+			for (unsigned int b = 0; b < palette.size(); b++) {
+				glm::mat4 affine = affineToMat4(palette[b]);
+				float size = 1.0f, boneDifference = 0.0f;
+				for (int i = 0; i < 4; i++) {
+					for (int j = 0; j < 4; j++) {
+						size = std::max(size, std::abs(reference[b][i][j]));
+						boneDifference = std::max(boneDifference, std::abs(affine[i][j] - reference[b][i][j]));
+					}
+				}
+				difference = std::max(difference, boneDifference / size);
+			}
+		}
+	}
+
+	return reportCheck("affine palette", "3x4 against 4x4 composition over " + std::to_string(numPalettes) + " palettes",
+		difference, AFFINE_TOLERANCE);
+}
+
+//a crowd playing every clip at spread out times, every fourth instance bound to cache
+std::vector<AnimationInstance> createCrowd(const Animator &animator, unsigned int count, PoseCache &cache) {
+	std::vector<AnimationInstance> crowd(count, animator.createInstance());
+	for (unsigned int i = 0; i < count; i++) {
+		crowd[i].clip = animator.getNumClips() > 0 ? i % animator.getNumClips() : 0;
+		if (i % 4 == 0)
+			crowd[i].poseCache = &cache;
+	}
+	return crowd;
+}
+
+//bone entries of a and b that aren't bit identical
+unsigned int countMismatches(const Affine* a, const Affine* b, size_t count) {
+	unsigned int mismatches = 0;
+	for (size_t i = 0; i < count; i++)
+		mismatches += std::memcmp(&a[i], &b[i], sizeof(Affine)) != 0 ? 1 : 0;
+	return mismatches;
+}
+
+bool checkBatchDeterminism(const Animator &animator) {
+	const unsigned int numInstances = 300;
+	const unsigned int numFrames = 12;
+	const unsigned int threadCounts[] = { 1, 2, 4, 8 };
+	unsigned int numBones = animator.getNumBones();
+	unsigned int mismatches = 0, numCompared = 0;
+	if (numBones == 0)
+		return reportCheck("batch determinism", "no bones to compare", 0.0f, 0.0f);
+
+	std::vector<std::vector<float>> times(numFrames, std::vector<float>(numInstances));
+	std::vector<float> distances(numInstances), screenSizes(numInstances, 1.0f);
+	for (unsigned int i = 0; i < numInstances; i++) {
+		distances[i] = (float)(i % 7) * 250.0f;
+		for (unsigned int f = 0; f < numFrames; f++)
+			times[f][i] = f / 60.0f + i * 0.137f;
+	}
+
+	//one at a time on this thread, the pose cache filled in instance order as forEachInstance fills it
+	PoseCache referenceCache(64, 30.0f);
+	std::vector<AnimationInstance> reference = createCrowd(animator, numInstances, referenceCache);
+	std::vector<std::vector<Affine>> referencePalettes(numFrames);
+	for (unsigned int f = 0; f < numFrames; f++) {
+		for (unsigned int i = 0; i < numInstances; i++) {
+			animator.update(reference[i], times[f][i]);
+			referencePalettes[f].insert(referencePalettes[f].end(), reference[i].palette.begin(), reference[i].palette.end());
+		}
+	}
+
+	//lod has no serial path to compare with, so its reference is itself on one thread
+	std::vector<std::vector<Affine>> lodPalettes(numFrames);
+
+	for (unsigned int t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++) {
+		JobSystem jobs(threadCounts[t]);
+		PoseCache batchCache(64, 30.0f), schedulerCache(64, 30.0f), pipelineCache(64, 30.0f), lodCache(64, 30.0f);
+		std::vector<AnimationInstance> batch = createCrowd(animator, numInstances, batchCache);
+		std::vector<AnimationInstance> scheduled = createCrowd(animator, numInstances, schedulerCache);
+		std::vector<AnimationInstance> pipelined = createCrowd(animator, numInstances, pipelineCache);
+		std::vector<AnimationInstance> lodCrowd = createCrowd(animator, numInstances, lodCache);
+
+		//every instance every frame, so the scheduler's order is the only thing it changes
+		SchedulerSettings schedulerSettings;
+		schedulerSettings.minUpdates = numInstances;
+		AnimationScheduler scheduler(schedulerSettings);
+		AnimationPipeline pipeline(animator, jobs);
+		AnimationLod lod;
+
+		for (unsigned int f = 0; f < numFrames; f++) {
+			animator.update(batch.data(), times[f].data(), numInstances, jobs);
+			scheduler.update(animator, scheduled.data(), times[f].data(), screenSizes.data(), numInstances, jobs);
+			pipeline.begin(pipelined.data(), times[f].data(), numInstances);
+			const Affine* pipelinePalettes = pipeline.end();
+			lod.update(animator, lodCrowd.data(), times[f].data(), distances.data(), numInstances, jobs);
+
+			for (unsigned int i = 0; i < numInstances; i++) {
+				const Affine* expected = &referencePalettes[f][(size_t)i * numBones];
+				mismatches += countMismatches(batch[i].palette.data(), expected, numBones);
+				mismatches += countMismatches(scheduled[i].palette.data(), expected, numBones);
+				mismatches += countMismatches(pipelinePalettes + (size_t)i * numBones, expected, numBones);
+				numCompared += 3;
+
+				if (t == 0)
+					lodPalettes[f].insert(lodPalettes[f].end(), lodCrowd[i].palette.begin(), lodCrowd[i].palette.end());
+				else {
+					mismatches += countMismatches(lodCrowd[i].palette.data(), &lodPalettes[f][(size_t)i * numBones], numBones);
+					numCompared++;
+				}
+			}
+		}
+	}
+
+	return reportCheck("batch determinism", "bones not bit identical over " + std::to_string(numCompared) + " palettes at 1 to 8 threads",
+		(float)mismatches, 0.0f);
+}
+
+bool runSelfChecks(Model &model) {
+	unsigned int passed = 0, total = 0;
+
+	total++;
+	passed += checkPoseSampler(model.getAnimator()) ? 1 : 0;
+#if defined(SELF_CHECK_ALLOCATIONS)
+	total++;
+	passed += checkPaletteAllocations(model.getAnimator()) ? 1 : 0;
+#else
+	std::cout << "SKIP palette allocations: needs a build with SELF_CHECK_ALLOCATIONS defined to count them" << std::endl;
+#endif
+	total++;
+	passed += checkDualQuatSkinning(model.getAnimator()) ? 1 : 0;
+	total++;
+	passed += checkAffinePalette(model.getAnimator()) ? 1 : 0;
+	total++;
+	passed += checkBatchDeterminism(model.getAnimator()) ? 1 : 0;
+
+	std::cout << passed << " of " << total << " self checks passed" << std::endl;
+	return passed == total;
+}
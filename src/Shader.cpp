@@ -2,7 +2,7 @@
 
 void handleErrors(unsigned int el, char type);
 
-Shader::Shader(const char *vPath, const char *fPath) {
+Shader::Shader(const char *vPath, const char *fPath, const std::string &defines) {
 	std::string vCode, fCode;
 	std::ifstream vFile;
 	std::ifstream fFile;
@@ -29,6 +29,11 @@ Shader::Shader(const char *vPath, const char *fPath) {
 		std::cout << "ShaderProgramError: Could not load shader files." << std::endl;
 	}
 
+	if (!defines.empty()) {
+		size_t versionEnd = vCode.find('\n');
+		vCode.insert(versionEnd == std::string::npos ? vCode.size() : versionEnd + 1, defines);
+	}
+
 	const char* vSrc = vCode.c_str();
 	const char* fSrc = fCode.c_str();
 
@@ -97,4 +102,10 @@ void Shader::setVec3(const std::string &name, glm::vec3 value) const {
 
 void Shader::setMat4(const std::string &name, glm::mat4 value) const {
 	glUniformMatrix4fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::setBlock(const std::string &name, unsigned int binding) const {
+	unsigned int index = glGetUniformBlockIndex(id, name.c_str());
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(id, index, binding);
 }
\ No newline at end of file
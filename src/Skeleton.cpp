@@ -0,0 +1,119 @@
+#include "Skeleton.h"
+
+glm::mat4 castMat4(const aiMatrix4x4 &mat);
+
+Skeleton::Skeleton(const aiNode* root) {
+	flattenHierarchy(root, -1);
+}
+
+Skeleton::Skeleton(CacheReader &reader) {
+	reader.readArray(joints);
+	jointNames.resize(joints.size());
+	for (unsigned int i = 0; i < jointNames.size(); i++) {
+		jointNames[i] = reader.readString();
+		jointMap[jointNames[i]] = i;
+	}
+
+	reader.readArray(boneInfo);
+	for (unsigned int i = 0; i < boneInfo.size(); i++) {
+		boneMap[reader.readString()] = i;
+	}
+
+	//evaluation indexes these directly, parents have to come before their children as flattenHierarchy leaves them
+	for (unsigned int i = 0; i < joints.size(); i++) {
+		bool parentValid = joints[i].parent >= -1 && joints[i].parent < (int)i;
+		bool boneValid = joints[i].boneId >= -1 && joints[i].boneId < (int)boneInfo.size();
+		if (!parentValid || !boneValid) {
+			reader.setFailed();
+			return;
+		}
+	}
+}
+
+void Skeleton::write(CacheWriter &writer) const {
+	writer.writeArray(joints);
+	for (unsigned int i = 0; i < jointNames.size(); i++) {
+		writer.writeString(jointNames[i]);
+	}
+
+	std::vector<std::string> boneNames(boneInfo.size());
+	for (std::map<std::string, unsigned int>::const_iterator bone = boneMap.begin(); bone != boneMap.end(); ++bone) {
+		boneNames[bone->second] = bone->first;
+	}
+
+	writer.writeArray(boneInfo);
+	for (unsigned int i = 0; i < boneNames.size(); i++) {
+		writer.writeString(boneNames[i]);
+	}
+}
+
+void Skeleton::flattenHierarchy(const aiNode* node, int parent) {
+	std::string nodeName(node->mName.data);
+
+	Joint joint;
+	joint.parent = parent;
+	joint.bindLocal = affineFromMat4(castMat4(node->mTransformation));
+	joint.boneId = -1;
+
+	int jointId = (int)joints.size();
+	joints.push_back(joint);
+	jointNames.push_back(nodeName);
+	jointMap[nodeName] = jointId;
+
+	for (unsigned int i = 0; i < node->mNumChildren; i++) {
+		flattenHierarchy(node->mChildren[i], jointId);
+	}
+}
+
+void Skeleton::loadBones(unsigned int meshId, const aiMesh* mesh, std::vector<VertexBoneData> &bones, const std::vector<unsigned int> &baseVertex) {
+	for (unsigned int i = 0; i < mesh->mNumBones; i++) {
+		unsigned int boneId = 0;
+		std::string boneName(mesh->mBones[i]->mName.data);
+		if (boneMap.find(boneName) == boneMap.end()) {
+			boneId = (unsigned int)boneInfo.size();
+			BoneInfo bi;
+			bi.offset = affineFromMat4(castMat4(mesh->mBones[i]->mOffsetMatrix));
+			boneInfo.push_back(bi);
+			boneMap[boneName] = boneId;
+
+			int joint = findJoint(boneName);
+			if (joint >= 0) {
+				joints[joint].boneId = boneId;
+			}
+		}
+		else {
+			boneId = boneMap[boneName];
+		}
+
+		for (unsigned int j = 0; j < mesh->mBones[i]->mNumWeights; j++) {
+			unsigned int vertexId = baseVertex[meshId] + mesh->mBones[i]->mWeights[j].mVertexId;
+			float weight = mesh->mBones[i]->mWeights[j].mWeight;
+			bones[vertexId].addBoneData(boneId, weight);
+		}
+	}
+}
+
+unsigned int Skeleton::getNumJoints() const {
+	return (unsigned int)joints.size();
+}
+
+const Joint& Skeleton::getJoint(unsigned int jointId) const {
+	return joints[jointId];
+}
+
+const std::string& Skeleton::getJointName(unsigned int jointId) const {
+	return jointNames[jointId];
+}
+
+int Skeleton::findJoint(const std::string &name) const {
+	std::map<std::string, unsigned int>::const_iterator joint = jointMap.find(name);
+	return joint != jointMap.end() ? (int)joint->second : -1;
+}
+
+unsigned int Skeleton::getNumBones() const {
+	return (unsigned int)boneInfo.size();
+}
+
+const BoneInfo& Skeleton::getBone(unsigned int boneId) const {
+	return boneInfo[boneId];
+}